@@ -0,0 +1,136 @@
+import ctypes
+from typing import List
+
+import numpy as np
+
+# breadth first state enumeration in twency48 (see twency48/src/enumerate.c)
+# the frontier is three columns owned by the library, exposed as numpy arrays without copying
+# each expand builds new columns, the views of an earlier expand keep theirs until they are gone
+# usage: f = Frontier(); f.expand(board.get_tiles(), board.get_score(), plies=4)
+#        expected = (f.probs * f.scores).sum()
+
+SPAWN = 0
+MOVE = 1
+
+MOVES_ALL = 0
+MOVES_GREEDY = 1
+
+# snake path of estimate_score
+PATH = [3, 2, 1, 0, 4, 5, 6, 7, 11, 10, 9, 8, 12, 13, 14, 15]
+
+
+class _Frontier(ctypes.Structure):
+    _fields_ = [
+        ('boards', ctypes.POINTER(ctypes.c_uint64)),
+        ('probs', ctypes.POINTER(ctypes.c_double)),
+        ('scores', ctypes.POINTER(ctypes.c_double)),
+        ('count', ctypes.c_uint64),
+        ('capacity', ctypes.c_uint64),
+        ('dropped_mass', ctypes.c_double),
+        ('plies', ctypes.c_int),
+    ]
+
+
+def pack(tiles: List[int]) -> int:
+    # tile values (2, 4, ...) to a packed board, tile 0 in the lowest 4 bits
+    # a nibble holds powers up to 15, so boards with tiles past 32768 cannot be packed
+    board = 0
+    for i, value in enumerate(tiles):
+        if value:
+            power = int(value).bit_length() - 1
+            if power > 15:
+                raise ValueError(f'tile {value} is larger than 32768 and cannot be packed')
+            board |= power << (4 * i)
+    return board
+
+
+def unpack(boards: np.ndarray) -> np.ndarray:
+    # packed boards to an (n, 16) array of power rep tiles
+    shifts = np.arange(16, dtype=np.uint64) * np.uint64(4)
+    return ((boards[:, None] >> shifts) & np.uint64(0xF)).astype(np.int8)
+
+
+def path_penalty(boards: np.ndarray) -> np.ndarray:
+    # the path penalty of estimate_score for every packed board
+    powers = unpack(boards).astype(np.int64)
+    tiles = np.where(powers > 0, np.left_shift(1, powers), 0)[:, PATH]
+    return np.maximum(tiles[:, :-1] - tiles[:, 1:], 0).sum(axis=1)
+
+
+class _Columns:
+    # the columns built by one expand, freed once the Frontier and every view of them are gone
+    def __init__(self, lib):
+        self.lib = lib
+        self.frontier = _Frontier()
+
+    def __del__(self):
+        self.lib.frontier_free(ctypes.byref(self.frontier))
+
+
+class _Column:
+    # one column of a frontier as seen by numpy, the view's base, so it keeps its columns alive
+    def __init__(self, columns: _Columns, pointer, count: int, dtype):
+        self.columns = columns
+        self.__array_interface__ = {'version': 3, 'shape': (count,), 'typestr': np.dtype(dtype).str,
+                                    'data': (ctypes.cast(pointer, ctypes.c_void_p).value, True)}
+
+
+class Frontier:
+
+    def __init__(self, lib_path: str = './twency48.so'):
+        self.lib = ctypes.CDLL(lib_path)
+        self.lib.enumerate_states.argtypes = (ctypes.POINTER(_Frontier), ctypes.c_uint64, ctypes.c_int, ctypes.c_int, ctypes.c_int,
+                                              ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.c_uint64, ctypes.c_double)
+        self.lib.enumerate_states.restype = ctypes.c_int
+        self.lib.frontier_free.argtypes = (ctypes.POINTER(_Frontier),)
+        self.columns = _Columns(self.lib)
+
+    def expand(self, tiles: List[int], score: int, first_ply: int = SPAWN, plies: int = -1, policy: int = MOVES_ALL,
+               params: List[float] = None, max_states: int = 100000, min_prob: float = 0.0) -> int:
+        """
+        replaces the frontier with the states plies plies after tiles (tile values)
+        :param first_ply: SPAWN if tiles are waiting for a spawn, MOVE if they are waiting for a move
+        :param plies: plies to expand, -1 to expand while the next ply has at most max_states states
+        :param policy: MOVES_ALL for every move with equal probability, MOVES_GREEDY for the greedy move
+        :param params: get_next_move style params, [1] and [3] are used by MOVES_GREEDY
+        :param max_states: states kept per ply, the least likely are dropped, 0 for no cap
+        :param min_prob: states less likely than this are dropped
+        :return: plies expanded, views of an earlier expand keep the states they were taken from
+        """
+        params = params if params is not None else [0, 10.282501707392333, 0.0, 4.480025944804589]
+        c_params = (ctypes.c_double * len(params))(*params)
+        # fresh columns, enumerate_states would free or grow the old ones under their views
+        columns = _Columns(self.lib)
+        plies = self.lib.enumerate_states(ctypes.byref(columns.frontier), pack(tiles), score, first_ply, plies, policy,
+                                          c_params, max_states, min_prob)
+        if plies < 0:
+            raise MemoryError('enumerate_states failed')
+        self.columns = columns
+        return plies
+
+    def _view(self, pointer, dtype) -> np.ndarray:
+        # read only, the states of the expand it was taken from
+        count = self.columns.frontier.count
+        if not count:
+            return np.zeros(0, dtype=dtype)
+        return np.asarray(_Column(self.columns, pointer, count, dtype))
+
+    @property
+    def boards(self) -> np.ndarray:
+        return self._view(self.columns.frontier.boards, np.uint64)
+
+    @property
+    def probs(self) -> np.ndarray:
+        return self._view(self.columns.frontier.probs, np.float64)
+
+    @property
+    def scores(self) -> np.ndarray:
+        # probability weighted mean score of the paths reaching each state
+        return self._view(self.columns.frontier.scores, np.float64)
+
+    @property
+    def dropped_mass(self) -> float:
+        return self.columns.frontier.dropped_mass
+
+    def __len__(self) -> int:
+        return self.columns.frontier.count
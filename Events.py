@@ -0,0 +1,76 @@
+import json
+import struct
+import sys
+
+# converts the event files written by events_drain (see twency48/src/events.c) to Chrome trace JSON,
+# which chrome://tracing and https://ui.perfetto.dev open directly
+# usage: python Events.py events.bin events.json
+
+HEADER_SIZE = 16
+MAGIC = b'T48EVNTS'
+VERSION = 1
+EVENT = struct.Struct('<QHHidd')
+
+MOVES = {0: 'right', 1: 'left', 2: 'up', 3: 'down'}
+
+SEARCH_BEGIN = 1
+SEARCH_END = 2
+ROOT_MOVE = 3
+ROLLOUTS = 4
+STOP = 5
+ARM = 6
+WIN_CONDITION = 7
+
+
+def load_events(path: str) -> list:
+    # returns (ns, type, thread, arg, value0, value1) for every event in the file, sorted by time
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) < HEADER_SIZE or data[:8] != MAGIC:
+        raise ValueError(f'{path} is not a twency48 event file')
+    version, item_size = struct.unpack_from('<II', data, 8)
+    if version != VERSION or item_size != EVENT.size:
+        raise ValueError(f'{path} has version {version}, item size {item_size}')
+    end = HEADER_SIZE + (len(data) - HEADER_SIZE) // EVENT.size * EVENT.size
+    return sorted(EVENT.iter_unpack(data[HEADER_SIZE:end]))
+
+
+def to_chrome_trace(events: list) -> dict:
+    # one track per thread, searches as slices, rollout batches as slices ending at their event,
+    # everything else as instant events
+    trace = []
+    threads = set()
+    for ns, kind, thread, arg, value0, value1 in events:
+        threads.add(thread)
+        base = {'pid': 0, 'tid': thread, 'ts': ns / 1000}
+        if kind == SEARCH_BEGIN:
+            trace.append({**base, 'name': 'search', 'ph': 'B', 'args': {'depth': arg}})
+        elif kind == SEARCH_END:
+            trace.append({**base, 'name': 'search', 'ph': 'E',
+                          'args': {'move': MOVES.get(arg, arg), 'nodes': int(value0), 'cutoffs': int(value1)}})
+        elif kind == ROOT_MOVE:
+            trace.append({**base, 'name': 'root move', 'ph': 'i', 's': 't',
+                          'args': {'move': MOVES.get(arg, arg), 'score': value0}})
+        elif kind == ROLLOUTS:
+            trace.append({**base, 'name': 'rollouts', 'ph': 'X', 'ts': (ns - value1) / 1000, 'dur': value1 / 1000,
+                          'args': {'rollouts': arg, 'mean score': value0}})
+        elif kind == STOP:
+            trace.append({**base, 'name': 'stop', 'ph': 'i', 's': 't',
+                          'args': {'trials': arg, 'statistic': value0, 'threshold met': bool(value1)}})
+        elif kind == ARM:
+            trace.append({**base, 'name': 'arm', 'ph': 'i', 's': 't',
+                          'args': {'move': MOVES.get(arg, arg), 'mean': value0, 'samples': int(value1)}})
+        elif kind == WIN_CONDITION:
+            condition = ''.join(str((arg >> (4 * j)) & 0xF) for j in range(8))
+            trace.append({**base, 'name': 'win condition', 'ph': 'i', 's': 't', 'args': {'condition': condition}})
+    for thread in sorted(threads):
+        trace.append({'pid': 0, 'tid': thread, 'ph': 'M', 'name': 'thread_name', 'args': {'name': f'thread {thread}'}})
+    return {'traceEvents': trace, 'displayTimeUnit': 'ms'}
+
+
+if __name__ == '__main__':
+    if len(sys.argv) != 3:
+        print('usage: python Events.py events.bin events.json')
+        sys.exit(2)
+    with open(sys.argv[2], 'w') as out:
+        json.dump(to_chrome_trace(load_events(sys.argv[1])), out)
@@ -0,0 +1,44 @@
+import ctypes
+from typing import Dict, List
+
+import numpy as np
+
+# bulk heuristic features of packed boards from twency48 (see twency48/src/features.c)
+# usage: columns = Features().extract(load_trace(path)['board'])
+#        pd.DataFrame(columns)
+
+# twency48.h Feature, column order of extract_features
+FEATURES = ['empty', 'max_tile', 'path_penalty', 'monotonicity', 'merges', 'moves']
+
+
+class Features:
+
+    def __init__(self, lib_path: str = './twency48.so'):
+        self.lib = ctypes.CDLL(lib_path)
+        self.lib.extract_features.argtypes = (ctypes.c_void_p, ctypes.c_uint64, ctypes.c_size_t,
+                                              ctypes.POINTER(ctypes.c_void_p), ctypes.c_int)
+        self.lib.extract_features.restype = ctypes.c_int
+
+    def extract(self, boards: np.ndarray, features: List[str] = None, threads: int = 0) -> Dict[str, np.ndarray]:
+        """
+        computes features of every board without copying the boards
+        :param boards: 1d array of packed boards (uint64), a strided view such as the board field of a trace works too
+        :param features: names from FEATURES, all of them by default
+        :return: an int32 array per feature, moves has bit m set when twency48.h Move m is valid
+        """
+        features = features if features is not None else FEATURES
+        if boards.ndim != 1 or boards.dtype != np.uint64:
+            raise ValueError('boards must be a 1d uint64 array')
+        unknown = set(features) - set(FEATURES)
+        if unknown:
+            raise ValueError(f'unknown features {sorted(unknown)}')
+        stride = boards.strides[0] if len(boards) else 8
+        if stride < 8:
+            boards = np.ascontiguousarray(boards)
+            stride = 8
+        columns = {name: np.empty(len(boards), dtype=np.int32) for name in features}
+        pointers = (ctypes.c_void_p * len(FEATURES))(*[columns[name].ctypes.data if name in columns else None
+                                                      for name in FEATURES])
+        if len(boards):
+            self.lib.extract_features(boards.ctypes.data, len(boards), stride, pointers, threads)
+        return columns
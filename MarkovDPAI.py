@@ -8,6 +8,17 @@ from AI import AI
 from abc import ABC, abstractmethod
 import time
 import ctypes
+from Enumerate import Frontier, SPAWN, MOVES_GREEDY, path_penalty
+
+try:
+    # CPython binding of the engines (twency48/src/pymodule.c, make -f twency48/build/makefile pymodule),
+    # the ctypes calls are used when it has not been built
+    import twency48_native
+except ImportError:
+    twency48_native = None
+
+# twency48.h Move order
+NATIVE_MOVES = [Board.Move.RIGHT, Board.Move.LEFT, Board.Move.UP, Board.Move.DOWN]
 
 class MarkovDPAI(AI):
     """
@@ -518,6 +529,30 @@ class ExpectiMax6(Policy):
         penalty += self.empty_space_pen * board_score * (16 - len(board.get_empty_squares()))
 
         return self.score_factor * board_score - penalty
+class FrontierExpectation(Policy):
+    """
+    ExpectiMax3's expectation over the boards a few plies ahead, enumerated natively (see Enumerate.py)
+    with identical boards merged, the greedy move played on each board and the least likely boards dropped
+    """
+
+    def __init__(self, depth: int = 3, max_states: int = 200000, path_pen: float = 10.282501707392333, score_factor: float = 4.480025944804589):
+        self.depth = depth
+        self.max_states = max_states
+        self.params = [0, path_pen, 0.0, score_factor]
+        self.frontier = Frontier()
+
+    def set_depth(self, depth: int):
+        self.depth = depth
+
+    def eval_score(self, board: Board, move: Board.Move) -> float:
+        board = board.move(move)
+        # depth spawns with a greedy move after each but the last
+        self.frontier.expand(board.get_tiles(), board.get_score(), SPAWN, 2 * self.depth - 1, MOVES_GREEDY,
+                             self.params, self.max_states)
+        values = self.params[3] * self.frontier.scores - self.params[1] * path_penalty(self.frontier.boards)
+        return float((self.frontier.probs * values).sum())
+
+
 class ScoreEst:
 
     @staticmethod
@@ -541,7 +576,15 @@ class ScoreEst:
 
 class ExpectiMax7(AI):
 
-    def __init__(self, depth=6, path_pen=10.282501707392333, loss_penalty = 0.0, score_factor=4.480025944804589):
+    def __init__(self, depth=6, path_pen=10.282501707392333, loss_penalty = 0.0, score_factor=4.480025944804589, ponder=False, tt=False, shared_tt=None, book=None, reuse=False):
+        # ponder: keep searching likely next boards in the background while the game applies the move
+        # one ponder search per process, games pondering at once are safe but rarely find their boards pondered
+        # tt: cache search nodes in a transposition table, same moves with fewer nodes searched
+        # reuse: with tt, answer the boards the last search reached after its move from that search (two plies
+        # shallower) instead of searching them, so about every other move is not searched
+        # shared_tt: name of a shared memory segment (eg. "/twency48_tt") holding the transposition table, shared by every process using the name
+        # book: opening book built by twency48/book with the same params and engine expectimax, expectimax_tt or packed
+        # (they pick the same moves), its positions are answered without searching
         self.loss_penalty = loss_penalty
         self.depth = depth
         self.position_penalty = 0
@@ -558,21 +601,66 @@ class ExpectiMax7(AI):
         
 
 
+        if ponder and tt:
+            raise ValueError('ponder and tt cannot be combined')
+        if reuse and not tt:
+            raise ValueError('reuse needs tt')
         self.lib = ctypes.CDLL('./twency48.so')
-        self.lib.get_next_move.argtypes = (ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double))
-        self.lib.get_next_move.restype = ctypes.c_int
-
-        self.c_params = (ctypes.c_double * len(self.params))(*self.params)
-
-
-
+        self.next_move = self.lib.get_next_move_ponder if ponder else self.lib.get_next_move
+        if tt:
+            self.next_move = self.lib.get_next_move_tt
+        # pondering and books built with another engine are only reached through ctypes
+        self.native = None
+        if twency48_native is not None and not ponder:
+            self.native = 'expectimax_tt' if tt else 'expectimax'
+        if shared_tt is not None:
+            self.lib.tt_attach_shared.argtypes = (ctypes.c_char_p, ctypes.c_int)
+            self.lib.tt_attach_shared(shared_tt.encode(), ctypes.c_int.in_dll(self.lib, 'tt_default_log2_entries').value)
+        self.next_move.argtypes = (ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double))
+        self.next_move.restype = ctypes.c_int
+
+        # padded with zeros, the engines read up to params[6], params[4] is get_next_move_tt's reuse
+        self.c_params = (ctypes.c_double * 8)(*self.params)
+        self.c_params[4] = 1 if reuse else 0
+
+        self.book_engine = None
+        if book is not None:
+            self.lib.book_open.argtypes = (ctypes.c_char_p,)
+            self.lib.book_open.restype = ctypes.c_longlong
+            if self.lib.book_open(book.encode()) < 0:
+                raise ValueError(f'{book} is not an opening book')
+            self.lib.book_accepts.argtypes = (ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.c_int)
+            self.lib.book_accepts.restype = ctypes.c_bool
+            # twency48.h Engine ids of expectimax, expectimax_tt and packed
+            for engine in (0, 2, 8):
+                if self.lib.book_accepts(engine, self.c_params, len(self.params)):
+                    self.book_engine = engine
+            if self.book_engine is None:
+                raise ValueError(f'{book} was not built for these params with expectimax, expectimax_tt or packed')
+            self.lib.book_move.argtypes = (ctypes.c_int, ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.c_int)
+            self.lib.book_move.restype = ctypes.c_int
+            if self.native is not None and self.book_engine != (2 if tt else 0):
+                self.native = None
+
+
+
+
+    def stop_ponder(self):
+        # stops the background search started by the last move, call it when a ponder=True game is over
+        self.lib.ponder_stop()
 
     def get_input(self, board:Board) -> Board.Move:
         score = board.get_score()
         tiles = board.get_tiles()
         
+        if self.native is not None:
+            return NATIVE_MOVES[twency48_native.search(self.native, tiles, self.c_params, score).move]
         c_tiles = (ctypes.c_int * len(tiles))(*tiles)
-        result = self.lib.get_next_move(c_tiles, score, self.c_params)
+        result = -1
+        if self.book_engine is not None:
+            result = self.lib.book_move(self.book_engine, c_tiles, score, self.c_params, len(self.params))
+        if result < 0:
+            result = self.next_move(c_tiles, score, self.c_params)
         move = board.Move.UP
         if result == 2:
             move = Board.Move.UP
@@ -587,7 +675,13 @@ class ExpectiMax7(AI):
     
 class ExpectiMax8(AI):
 
-    def __init__(self, depth = 7, path_pen=0.45127922428126166, loss_penalty=12.544226964630045, score_factor=0.12761368167679277, num_trials=1000):
+    def __init__(self, depth = 7, path_pen=0.45127922428126166, loss_penalty=12.544226964630045, score_factor=0.12761368167679277, num_trials=1000, ponder=False, tt=False, shared_tt=None, rollout_threads=1, reuse=False):
+        # rollout_threads: threads playing the rollouts of each leaf (twency48/src/pool.c), 0 for one per core, shared by the process
+        # ponder: keep searching likely next boards in the background while the game applies the move
+        # one ponder search per process, games pondering at once are safe but rarely find their boards pondered
+        # tt: cache search nodes in a transposition table, same moves with fewer nodes searched
+        # reuse: with tt, answer the boards the last search reached after its move from that search, as ExpectiMax7
+        # shared_tt: name of a shared memory segment (eg. "/twency48_tt") holding the transposition table, shared by every process using the name
         self.loss_penalty = loss_penalty
         self.depth = depth
         self.position_penalty = 0
@@ -607,14 +701,36 @@ class ExpectiMax8(AI):
         
 
 
+        if ponder and tt:
+            raise ValueError('ponder and tt cannot be combined')
+        if reuse and not tt:
+            raise ValueError('reuse needs tt')
         self.lib = ctypes.CDLL('./twency48.so')
-        self.lib.get_next_move1.argtypes = (ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double))
-        self.lib.get_next_move1.restype = ctypes.c_int
+        self.next_move = self.lib.get_next_move1_ponder if ponder else self.lib.get_next_move1
+        if tt:
+            self.next_move = self.lib.get_next_move1_tt
+        # pondering is only reached through ctypes
+        self.native = None
+        if twency48_native is not None and not ponder:
+            self.native = 'expectimax1_tt' if tt else 'expectimax1'
+        if shared_tt is not None:
+            self.lib.tt_attach_shared.argtypes = (ctypes.c_char_p, ctypes.c_int)
+            self.lib.tt_attach_shared(shared_tt.encode(), ctypes.c_int.in_dll(self.lib, 'tt_default_log2_entries').value)
+        self.next_move.argtypes = (ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double))
+        self.next_move.restype = ctypes.c_int
+        if rollout_threads != 1:
+            self.lib.rollout_pool_init(rollout_threads)
+
+        # padded with zeros, params[5] is get_next_move1_tt's reuse
+        self.c_params = (ctypes.c_double * 8)(*self.params)
+        self.c_params[5] = 1 if reuse else 0
 
-        self.c_params = (ctypes.c_double * len(self.params))(*self.params)
 
 
 
+    def stop_ponder(self):
+        # stops the background search started by the last move, call it when a ponder=True game is over
+        self.lib.ponder_stop()
 
     def get_input(self, board:Board) -> Board.Move:
         score = board.get_score()
@@ -632,8 +748,10 @@ class ExpectiMax8(AI):
 
         # print(max_tile, self.params)
         
+        if self.native is not None:
+            return NATIVE_MOVES[twency48_native.search(self.native, tiles, self.c_params, score).move]
         c_tiles = (ctypes.c_int * len(tiles))(*tiles)
-        result = self.lib.get_next_move1(c_tiles, score, self.c_params)
+        result = self.next_move(c_tiles, score, self.c_params)
         move = board.Move.UP
         if result == 2:
             move = Board.Move.UP
@@ -705,6 +823,8 @@ class MCTS(AI):
         elif max_tile == 4096:
             self.turns = self.turns_4096
 
+        if twency48_native is not None:
+            return NATIVE_MOVES[twency48_native.search('mcts', tiles, self.params, score).move]
         c_tiles = (ctypes.c_int * len(tiles))(*tiles)
         self.c_params = (ctypes.c_double * len(self.params))(*self.params)
         result = self.lib.get_MCTS_next_move(c_tiles, score, self.c_params)
@@ -764,6 +884,8 @@ class MCTS1(AI):
         # self.c_params[4] = max(max_tile + 1, 7)
         
 
+        if twency48_native is not None:
+            return NATIVE_MOVES[twency48_native.search('mcts1', tiles, self.params, score).move]
         c_tiles = (ctypes.c_int * len(tiles))(*tiles)
         self.c_params = (ctypes.c_double * len(self.params))(*self.params)
         result = self.lib.get_MCTS_next_move1(c_tiles, score, self.c_params)
@@ -782,8 +904,10 @@ class MCTS1(AI):
 class MCTS2(AI):
 
     def __init__(self, 
-                 game_runs = 100
+                 game_runs = 100,
+                 rollout_threads = 1
                  ):
+        # rollout_threads: threads playing the rollouts of each move (twency48/src/pool.c), 0 for one per core, shared by the process
         self.game_runs = game_runs
 
         self.params = [
@@ -794,6 +918,8 @@ class MCTS2(AI):
         self.lib = ctypes.CDLL('./twency48.so')
         self.lib.get_MCTS_next_move2.argtypes = (ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double))
         self.lib.get_MCTS_next_move2.restype = ctypes.c_int
+        if rollout_threads != 1:
+            self.lib.rollout_pool_init(rollout_threads)
 
 
 
@@ -808,6 +934,8 @@ class MCTS2(AI):
         # self.c_params[4] = max(max_tile + 1, 7)
         
 
+        if twency48_native is not None:
+            return NATIVE_MOVES[twency48_native.search('mcts2', tiles, self.params, score).move]
         c_tiles = (ctypes.c_int * len(tiles))(*tiles)
         self.c_params = (ctypes.c_double * len(self.params))(*self.params)
         result = self.lib.get_MCTS_next_move2(c_tiles, score, self.c_params)
@@ -826,8 +954,10 @@ class MCTS2(AI):
 class MCTS3(AI):
 
     def __init__(self, 
-                 game_runs = 100
+                 game_runs = 100,
+                 rollout_threads = 1
                  ):
+        # rollout_threads: threads playing the rollouts of each move (twency48/src/pool.c), 0 for one per core, shared by the process
         self.game_runs = game_runs
 
         self.params = [
@@ -842,6 +972,8 @@ class MCTS3(AI):
         self.lib = ctypes.CDLL('./twency48.so')
         self.lib.get_MCTS_next_move3.argtypes = (ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double))
         self.lib.get_MCTS_next_move3.restype = ctypes.c_int
+        if rollout_threads != 1:
+            self.lib.rollout_pool_init(rollout_threads)
 
 
 
@@ -856,6 +988,8 @@ class MCTS3(AI):
         # self.c_params[4] = max(max_tile + 1, 7)
         
 
+        if twency48_native is not None:
+            return NATIVE_MOVES[twency48_native.search('mcts3', tiles, self.params, score).move]
         c_tiles = (ctypes.c_int * len(tiles))(*tiles)
         self.c_params = (ctypes.c_double * len(self.params))(*self.params)
         result = self.lib.get_MCTS_next_move3(c_tiles, score, self.c_params)
@@ -870,4 +1004,92 @@ class MCTS3(AI):
             move = Board.Move.RIGHT
         # print(move)
         return move
-    
\ No newline at end of file
+
+
+class UCT(AI):
+
+    def __init__(self,
+                 iterations = 500,
+                 exploration = 1.0,
+                 widening_k = 1.0,
+                 widening_alpha = 0.5,
+                 threads = 1
+                 ):
+        # tree search with decision and chance nodes (twency48/src/uct.c), iterations rollouts per move
+        # chance nodes get a child for a new spawn while they have fewer than widening_k * visits^widening_alpha
+        # threads: threads searching the same tree
+        self.params = [
+            iterations,
+            exploration,
+            widening_k,
+            widening_alpha,
+            threads
+        ]
+
+        self.lib = ctypes.CDLL('./twency48.so')
+        self.lib.get_next_move_uct.argtypes = (ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double))
+        self.lib.get_next_move_uct.restype = ctypes.c_int
+        self.c_params = (ctypes.c_double * len(self.params))(*self.params)
+
+    def get_input(self, board:Board) -> Board.Move:
+        score = board.get_score()
+        tiles = board.get_tiles()
+
+        c_tiles = (ctypes.c_int * len(tiles))(*tiles)
+        result = self.lib.get_next_move_uct(c_tiles, score, self.c_params)
+        move = board.Move.UP
+        if result == 2:
+            move = Board.Move.UP
+        if result == 3:
+            move = Board.Move.DOWN
+        if result == 1:
+            move = Board.Move.LEFT
+        if result == 0:
+            move = Board.Move.RIGHT
+        return move
+
+
+class MCTSHalving(AI):
+
+    def __init__(self,
+                 budget = 80,
+                 path_pen = 10.282501707392333,
+                 loss_penalty = 0,
+                 score_factor = 4.480025944804589,
+                 rollout_policy = 0,
+                 rollout_threads = 1
+                 ):
+        # MCTS2 with a total rollout budget (twency48/src/halving.c), the worse half of the moves is dropped after each round
+        # rollout_policy: twency48.h RolloutPolicy, the weights are used by the greedy and em policies
+        # rollout_threads: threads playing the rollouts of each move (twency48/src/pool.c), 0 for one per core, shared by the process
+        self.params = [
+            budget,
+            path_pen,
+            loss_penalty,
+            score_factor,
+            rollout_policy
+        ]
+
+        self.lib = ctypes.CDLL('./twency48.so')
+        self.lib.get_MCTS_next_move_halving.argtypes = (ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.POINTER(ctypes.c_double))
+        self.lib.get_MCTS_next_move_halving.restype = ctypes.c_int
+        if rollout_threads != 1:
+            self.lib.rollout_pool_init(rollout_threads)
+        self.c_params = (ctypes.c_double * len(self.params))(*self.params)
+
+    def get_input(self, board:Board) -> Board.Move:
+        score = board.get_score()
+        tiles = board.get_tiles()
+
+        c_tiles = (ctypes.c_int * len(tiles))(*tiles)
+        result = self.lib.get_MCTS_next_move_halving(c_tiles, score, self.c_params)
+        move = board.Move.UP
+        if result == 2:
+            move = Board.Move.UP
+        if result == 3:
+            move = Board.Move.DOWN
+        if result == 1:
+            move = Board.Move.LEFT
+        if result == 0:
+            move = Board.Move.RIGHT
+        return move
@@ -0,0 +1,99 @@
+import socket
+import struct
+import itertools
+from typing import List, Tuple
+
+from twenty48.Board import Board
+from AI import AI
+
+# client for the move server (twency48/server, see twency48/src/server.c), which keeps one warm engine
+# for every local process instead of each loading twency48.so and building its own tables
+# usage: twency48/server -s /tmp/twency48.sock &
+#        ai = RemoteAI('packed', [5, 10.282501707392333, 0.0, 4.480025944804589])
+
+REQUEST = struct.Struct('<IIii16BIi8d')
+RESPONSE = struct.Struct('<IIiiQff')
+REQUEST_MAGIC = 0x51383454
+RESPONSE_MAGIC = 0x52383454
+MAX_PARAMS = 8
+
+OK = 0
+BUSY = 1
+BAD_REQUEST = 2
+
+# twency48.h Engine, the tt engines share state between calls and are refused by the server
+ENGINES = {'expectimax': 0, 'expectimax1': 1, 'mcts': 4, 'mcts1': 5, 'mcts2': 6, 'mcts3': 7,
+           'packed': 8, 'packed_pruned': 9, 'packed_rollout': 10, 'packed_sampled': 11, 'uct': 12,
+           'mcts_halving': 13}
+MOVES = {0: Board.Move.RIGHT, 1: Board.Move.LEFT, 2: Board.Move.UP, 3: Board.Move.DOWN}
+
+
+class ServerBusy(Exception):
+    pass
+
+
+class MoveClient:
+
+    def __init__(self, path: str = '/tmp/twency48.sock'):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.ids = itertools.count()
+        self.answers = {}
+
+    def close(self):
+        self.sock.close()
+
+    def send(self, engine: int, tiles: List[int], score: int, params: List[float], budget_us: int = 0) -> int:
+        # queues a request without waiting for it, tiles are tile values (2, 4, ...), returns its id
+        if len(params) > MAX_PARAMS:
+            raise ValueError(f'at most {MAX_PARAMS} params')
+        request_id = next(self.ids) & 0xFFFFFFFF
+        powers = [value.bit_length() - 1 if value else 0 for value in map(int, tiles)]
+        padded = list(params) + [0.0] * (MAX_PARAMS - len(params))
+        self.sock.sendall(REQUEST.pack(REQUEST_MAGIC, request_id, engine, score, *powers,
+                                       budget_us, len(params), *padded))
+        return request_id
+
+    def receive(self, request_id: int) -> dict:
+        # waits for the answer to request_id, answers may come back in any order
+        while request_id not in self.answers:
+            data = b''
+            while len(data) < RESPONSE.size:
+                chunk = self.sock.recv(RESPONSE.size - len(data))
+                if not chunk:
+                    raise ConnectionError('move server closed the connection')
+                data += chunk
+            magic, answer_id, move, status, nodes, search_us, queue_us = RESPONSE.unpack(data)
+            if magic != RESPONSE_MAGIC:
+                raise ConnectionError('not a move server response')
+            self.answers[answer_id] = {'move': move, 'status': status, 'nodes': nodes,
+                                       'search_us': search_us, 'queue_us': queue_us}
+        return self.answers.pop(request_id)
+
+    def get_move(self, engine: int, tiles: List[int], score: int, params: List[float], budget_us: int = 0) -> Tuple[int, dict]:
+        # returns the engine's move (twency48.h Move) and the response, raises ServerBusy if the request was refused
+        answer = self.receive(self.send(engine, tiles, score, params, budget_us))
+        if answer['status'] == BUSY:
+            raise ServerBusy(f'refused, budget {budget_us}us')
+        if answer['status'] != OK:
+            raise ValueError('bad request, the server only runs stateless engines with 1 to 8 params')
+        return answer['move'], answer
+
+
+class RemoteAI(AI):
+
+    def __init__(self, engine: str = 'packed', params: List[float] = None, path: str = '/tmp/twency48.sock', budget_us: int = 0):
+        # engine: a name from ENGINES, params: laid out as in get_next_move
+        # budget_us: latency budget per move, the server refuses moves it cannot answer in time
+        self.engine = ENGINES[engine]
+        self.params = params if params is not None else [5, 10.282501707392333, 0.0, 4.480025944804589]
+        self.budget_us = budget_us
+        self.client = MoveClient(path)
+
+    def get_input(self, board: Board) -> Board.Move:
+        # a refused move is retried without a budget rather than dropping the game
+        try:
+            move, _ = self.client.get_move(self.engine, board.get_tiles(), board.get_score(), self.params, self.budget_us)
+        except ServerBusy:
+            move, _ = self.client.get_move(self.engine, board.get_tiles(), board.get_score(), self.params)
+        return MOVES.get(move, Board.Move.UP)
@@ -1,4 +1,5 @@
 import time
+import ctypes
 from abc import ABC, abstractmethod
 import multiprocessing as mp
 import numpy as np
@@ -11,6 +12,10 @@ from twenty48.Input import Input
 from twenty48.Display import NoneDisplay, ProgressDisplay
 
 
+class GameResult(ctypes.Structure):
+    _fields_ = [('score', ctypes.c_int), ('max_tile', ctypes.c_int), ('turns', ctypes.c_int)]
+
+
 class Reporter(ABC):
 
     @abstractmethod
@@ -83,3 +88,105 @@ class LightConcurrentReporter(Reporter):
 
 
 
+
+class NativeReporter(Reporter):
+    # plays n games inside twency48 with seeded spawns, optionally recording every turn to a trace (see Trace.py)
+    ENGINES = {
+        'expectimax': 0,
+        'expectimax1': 1,
+        'expectimax_tt': 2,
+        'expectimax1_tt': 3,
+        'mcts': 4,
+        'mcts1': 5,
+        'mcts2': 6,
+        'mcts3': 7,
+        'packed': 8,
+        'packed_pruned': 9,
+        'packed_rollout': 10,
+        'packed_sampled': 11,
+        'uct': 12,
+        'mcts_halving': 13,
+    }
+
+    def __init__(self, engine: str, params: List[float], seed: int = 0, filename: str = None):
+        self.engine = self.ENGINES[engine]
+        self.params = params
+        self.seed = seed
+        self.filename = filename
+
+        self.lib = ctypes.CDLL('./twency48.so')
+        self.lib.play_games.argtypes = (ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.c_uint64, ctypes.c_int,
+                                        ctypes.c_char_p, ctypes.POINTER(GameResult))
+        self.lib.play_games.restype = ctypes.c_int
+
+    def generate_report(self, num_games: int = 5) -> list[float, float]:
+        # padded with zeros, the engines read up to params[6]
+        c_params = (ctypes.c_double * max(len(self.params), 8))(*self.params)
+        results = (GameResult * num_games)()
+        filename = self.filename.encode() if self.filename is not None else None
+        if self.lib.play_games(self.engine, c_params, self.seed, num_games, filename, results) < 0:
+            raise RuntimeError(f"could not open trace {self.filename}")
+        return [[r.score, r.max_tile] for r in results]
+
+
+class CheckpointedReporter(NativeReporter):
+    # NativeReporter on several threads, saving every game to a checkpoint so an interrupted run resumes where it
+    # stopped (see twency48/src/eval.c), results_path gets a line per game as it ends
+
+    def __init__(self, engine: str, params: List[float], checkpoint: str, seed: int = 0, threads: int = 0,
+                 interval: float = 60, results_path: str = None):
+        super().__init__(engine, params, seed)
+        self.checkpoint = checkpoint
+        self.threads = threads
+        self.interval = interval
+        self.results_path = results_path
+        self.lib.run_evaluation.argtypes = (ctypes.c_char_p, ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.c_int,
+                                            ctypes.c_uint64, ctypes.c_int, ctypes.c_int, ctypes.c_double, ctypes.c_char_p,
+                                            ctypes.POINTER(GameResult))
+        self.lib.run_evaluation.restype = ctypes.c_int
+
+    def generate_report(self, num_games: int = 100) -> list[float, float]:
+        # rerun with the same arguments to resume, the results of an earlier interrupted call are kept
+        c_params = (ctypes.c_double * len(self.params))(*self.params)
+        results = (GameResult * num_games)()
+        results_path = self.results_path.encode() if self.results_path is not None else None
+        finished = self.lib.run_evaluation(self.checkpoint.encode(), self.engine, c_params, len(self.params), self.seed,
+                                           num_games, self.threads, self.interval, results_path, results)
+        if finished < 0:
+            raise RuntimeError(f"could not run {self.checkpoint}, it may hold another run")
+        return [[r.score, r.max_tile] for r in results]
+
+
+class SweepStats(ctypes.Structure):
+    _fields_ = [('games', ctypes.c_int), ('mean_score', ctypes.c_double),
+                ('p2048', ctypes.c_double), ('p4096', ctypes.c_double), ('p8192', ctypes.c_double),
+                ('score_diff', ctypes.c_double), ('score_diff_ci', ctypes.c_double),
+                ('p2048_diff', ctypes.c_double), ('p2048_diff_ci', ctypes.c_double)]
+
+
+class NativeSweep:
+    # compares parameter sets by playing every set on the same seeded spawn sequences (common random numbers)
+    # differences are paired against the first set, so far fewer games are needed than with independent runs
+
+    def __init__(self, engine: str, param_sets: List[List[float]], seed: int = 0, threads: int = 0, filename: str = None):
+        self.engine = NativeReporter.ENGINES[engine]
+        self.param_sets = param_sets
+        self.seed = seed
+        self.threads = threads
+        self.filename = filename
+
+        self.lib = ctypes.CDLL('./twency48.so')
+        self.lib.run_sweep.argtypes = (ctypes.c_int, ctypes.POINTER(ctypes.c_double), ctypes.c_int, ctypes.c_int, ctypes.c_uint64,
+                                       ctypes.c_int, ctypes.c_int, ctypes.c_char_p, ctypes.POINTER(SweepStats))
+        self.lib.run_sweep.restype = ctypes.c_int
+
+    def generate_report(self, num_games: int = 100) -> list[dict]:
+        num_params = max(len(p) for p in self.param_sets)
+        flat = [x for p in self.param_sets for x in list(p) + [0.0] * (num_params - len(p))]
+        c_params = (ctypes.c_double * len(flat))(*flat)
+        stats = (SweepStats * len(self.param_sets))()
+        filename = self.filename.encode() if self.filename is not None else None
+        if self.lib.run_sweep(self.engine, c_params, len(self.param_sets), num_params, self.seed, num_games,
+                              self.threads, filename, stats) < 0:
+            raise RuntimeError("sweep failed")
+        return [{name: getattr(s, name) for name, _ in SweepStats._fields_} for s in stats]
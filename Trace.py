@@ -0,0 +1,87 @@
+import numpy as np
+
+# readers for the game traces written by twency48 (see twency48/src/trace.c)
+# a trace is two files, <path> with one record per turn and <path>.idx with one entry per game
+# both are flat arrays after a 16 byte header, so they are memory mapped rather than parsed
+
+HEADER_SIZE = 16
+MAGIC = b'T48TRACE'
+VERSION = 1
+
+RECORD_DTYPE = np.dtype([
+    ('board', '<u8'),        # packed board before the move, 4 bits per tile in power rep, tile 0 lowest, 0 if flags & 2
+    ('score', '<i4'),        # score before the move
+    ('score_delta', '<i4'),  # score gained by the move
+    ('move', 'i1'),          # 0: right, 1: left, 2: up, 3: down
+    ('spawn_cell', 'i1'),    # -1 if no tile was spawned
+    ('spawn_value', 'i1'),   # power rep
+    ('flags', 'u1'),         # 1 if nodes and search_us are set, 2 if the board has a tile past 32768 and was not recorded
+    ('nodes', '<u4'),
+    ('search_us', '<f4'),
+    ('game', '<u4'),
+])
+
+INDEX_DTYPE = np.dtype([
+    ('first_record', '<u8'),
+    ('num_records', '<u4'),
+    ('game', '<u4'),
+    ('score', '<i4'),
+    ('max_tile', '<i4'),
+    ('seed', '<u8'),
+])
+
+
+def _map(path: str, dtype: np.dtype) -> np.ndarray:
+    with open(path, 'rb') as f:
+        header = f.read(HEADER_SIZE)
+    if len(header) < HEADER_SIZE or header[:8] != MAGIC:
+        raise ValueError(f'{path} is not a twency48 trace')
+    version, item_size = np.frombuffer(header[8:], dtype='<u4')
+    if version != VERSION or item_size != dtype.itemsize:
+        raise ValueError(f'{path} has version {version}, item size {item_size}')
+    return np.memmap(path, dtype=dtype, mode='r', offset=HEADER_SIZE)
+
+
+def load_trace(path: str) -> np.ndarray:
+    # returns every turn in the trace as a read only structured array
+    return _map(path, RECORD_DTYPE)
+
+
+def load_index(path: str) -> np.ndarray:
+    # returns one entry per finished game of the trace at path
+    return _map(path + '.idx', INDEX_DTYPE)
+
+
+def game_turns(records: np.ndarray, index: np.ndarray, game: int) -> np.ndarray:
+    # returns the turns of one game, a view into records
+    entry = index[game]
+    first = int(entry['first_record'])
+    return records[first:first + int(entry['num_records'])]
+
+
+def unpack_boards(boards: np.ndarray) -> np.ndarray:
+    # converts packed boards to an (n, 16) array of tile powers, 0 for empty
+    shifts = np.arange(0, 64, 4, dtype=np.uint64)
+    return ((boards[:, None] >> shifts) & np.uint64(0xF)).astype(np.uint8)
+
+
+REEVAL_HEADER_SIZE = 72
+
+REEVAL_DTYPE = np.dtype([
+    ('board', '<u8'),
+    ('values', '<f4', (4,)),  # new score of each move, indexed by move, -inf if invalid
+    ('best_move', 'i1'),      # -1 for records without a board
+    ('recorded_move', 'i1'),
+    ('agree', 'u1'),
+    ('done', 'u1'),
+    ('delta', '<f4'),         # values[best_move] - values[recorded_move]
+])
+
+
+def load_reeval(path: str) -> np.ndarray:
+    # returns the output of twency48/reeval, one entry per record of the re-evaluated trace
+    with open(path, 'rb') as f:
+        header = f.read(REEVAL_HEADER_SIZE)
+    if header[:8] != b'T48REEVL':
+        raise ValueError(f'{path} is not a re-evaluation')
+    return np.memmap(path, dtype=REEVAL_DTYPE, mode='r', offset=REEVAL_HEADER_SIZE)
@@ -0,0 +1,58 @@
+import ctypes
+from statistics import NormalDist
+from typing import Dict, List
+
+from Enumerate import pack
+
+# win probability estimates from twency48 (see twency48/src/winprob.c)
+# usage: wp = WinProbability(); wp.estimate(board.get_tiles(), {1024: 2, 512: 1}, ci_width=0.02)
+
+RANDOM = 0
+GREEDY = 1
+CORNER = 2
+
+
+class _WinEstimate(ctypes.Structure):
+    _fields_ = [
+        ('probability', ctypes.c_double),
+        ('low', ctypes.c_double),
+        ('high', ctypes.c_double),
+        ('rollouts', ctypes.c_longlong),
+        ('wins', ctypes.c_longlong),
+        ('steps', ctypes.c_longlong),
+        ('rounds', ctypes.c_int),
+    ]
+
+
+class WinProbability:
+
+    def __init__(self, lib_path: str = './twency48.so'):
+        self.lib = ctypes.CDLL(lib_path)
+        self.lib.estimate_win_probability.argtypes = (ctypes.c_uint64, ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_int,
+                                                      ctypes.POINTER(ctypes.c_double), ctypes.c_double, ctypes.c_double,
+                                                      ctypes.c_int, ctypes.c_longlong, ctypes.c_int, ctypes.c_uint64,
+                                                      ctypes.POINTER(_WinEstimate))
+        self.lib.estimate_win_probability.restype = ctypes.c_int
+
+    def estimate(self, tiles: List[int], target: Dict[int, int], policy: int = RANDOM, first_move: int = -1,
+                 params: List[float] = None, ci_width: float = 0.02, confidence: float = 0.95, batch: int = 1024,
+                 max_rollouts: int = 1000000, threads: int = 0, seed: int = 1) -> dict:
+        """
+        estimates the probability of tiles (tile values) holding the target tiles at once before the game is lost
+        :param target: tile value to count, eg. {1024: 2, 512: 1}
+        :param policy: RANDOM, GREEDY or CORNER, params are used by GREEDY as in get_next_move
+        :param first_move: twency48.h Move played first, -1 to let the policy choose
+        :param ci_width: stops once the interval is at most this wide, 0 to play max_rollouts
+        :return: probability, low, high, rollouts, wins, steps and rounds
+        """
+        counts = [0] * 16
+        for value, count in target.items():
+            counts[int(value).bit_length() - 1] = count
+        params = params if params is not None else [0, 10.282501707392333, 0.0, 4.480025944804589]
+        c_params = (ctypes.c_double * len(params))(*params)
+        z = NormalDist().inv_cdf(0.5 + confidence / 2)
+        result = _WinEstimate()
+        if self.lib.estimate_win_probability(pack(tiles), (ctypes.c_int * 16)(*counts), first_move, policy, c_params,
+                                             ci_width, z, batch, max_rollouts, threads, seed, ctypes.byref(result)) != 0:
+            raise ValueError('estimate_win_probability refused the arguments')
+        return {name: getattr(result, name) for name, _ in _WinEstimate._fields_}
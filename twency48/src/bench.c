@@ -0,0 +1,346 @@
+#include <pthread.h>
+#include <string.h>
+#include "twency48.h"
+
+// End to end engine benchmark
+// Plays the same seeded games with each engine configuration, first on one thread and then on more
+// threads (independent games in parallel), and writes one JSON document with a fixed schema:
+//   {"schema": "twency48-bench", "version": 1, "label", "seed", "games", "threads": [...], "rollout_threads",
+//    "engines": [{"name", "engine", "params", "moves", "latency_us": {mean, p50, p90, p99, max},
+//                 "nodes", "nodes_per_s", "rollout_steps_per_s", "score": {mean, std, min, p10, p50, p90, max},
+//                 "tile_rates": {"512": ..., ..., "16384": ...}, "max_tiles": {"<tile>": games, ...},
+//                 "score_per_core_second",
+//                 "scaling": [{"threads", "seconds", "moves_per_s", "speedup", "efficiency"}, ...],
+//                 "perf": {"search": {"cycles", "instructions", ...}, "leaves": {...}, "rollouts": {...}}}]}
+// "perf" is only there with -p, with the totals of the counters the machine has (see perf.c).
+// "rollout_threads" is the size of the rollout pool (-r, see pool.c), 1 when rollouts are not pooled.
+// Latencies, nodes and the score statistics come from the one thread run, so they are not skewed
+// by cores competing for memory. Fields are only ever added, so old results stay comparable.
+// The engines' random numbers are seeded per game as in play_game, so every configuration except uct
+// on several threads scores the same games in every run and at every thread count.
+
+#define BENCH_SCHEMA_VERSION 1
+#define MAX_CONFIGS 32
+#define MAX_PARAMS 8
+
+typedef struct{
+    const char* name;
+    int engine;
+    double params[MAX_PARAMS];
+    int num_params;
+} BenchConfig;
+
+// cheap enough to run on every commit, the tuned parameters of MarkovDPAI.py where it has them
+static const BenchConfig default_configs[] = {
+    {"expectimax", ENGINE_EXPECTIMAX, {3, 10.282501707392333, 0.0, 4.480025944804589}, 4},
+    {"expectimax1", ENGINE_EXPECTIMAX1, {2, 0.45127922428126166, 12.544226964630045, 0.12761368167679277, 20}, 5},
+    {"packed", ENGINE_PACKED, {4, 10.282501707392333, 0.0, 4.480025944804589}, 4},
+    {"packed_pruned", ENGINE_PACKED_PRUNED, {5, 10.282501707392333, 0.0, 4.480025944804589, 1e-4}, 5},
+    {"mcts", ENGINE_MCTS, {0.99, 2000, 1e-3, 1000, 11, 50, 40}, 7},
+    {"mcts2", ENGINE_MCTS2, {20}, 1},
+    {"uct", ENGINE_UCT, {80, 1.0, 1.0, 0.5, 1}, 5},
+    {"mcts_halving", ENGINE_MCTS_HALVING, {80, 10.282501707392333, 0.0, 4.480025944804589, 0}, 5},
+};
+
+typedef struct{
+    double* latencies;      // us per move
+    long long num_moves;
+    long long capacity;
+    long long nodes;
+    long long rollout_steps;
+    double search_us;
+    PerfStats perf;         // totals over every move
+} MoveLog;
+
+typedef struct{
+    const BenchConfig* config;
+    uint64_t seed;
+    int num_games;
+    int next_game;          // shared counter, taken with __atomic_fetch_add
+    GameResult* results;
+    MoveLog* logs;          // one per thread
+} BenchJob;
+
+typedef struct{
+    BenchJob* job;
+    int thread;
+} BenchWorker;
+
+static double now_us(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec * 1e-3;
+}
+
+static void log_move(MoveLog* log, double us){
+    if(log->num_moves == log->capacity){
+        log->capacity = log->capacity ? 2 * log->capacity : 4096;
+        log->latencies = realloc(log->latencies, log->capacity * sizeof(double));
+    }
+    log->latencies[log->num_moves++] = us;
+}
+
+typedef struct{
+    MoveLog* log;
+    long long rollout_steps;    // rollout_steps after the last move
+} BenchGame;
+
+static bool bench_hook(void* context, const GameState* game, const Board* before, int move, int spawn_cell, int spawn_value, double search_us){
+    BenchGame* bench = context;
+    MoveLog* log = bench->log;
+    log_move(log, search_us);
+    log->search_us += search_us;
+    log->nodes += search_stats.nodes;
+    log->rollout_steps += rollout_steps - bench->rollout_steps;
+    bench->rollout_steps = rollout_steps;
+    log->perf.available |= search_stats.perf.available;
+    for(int p = 0; p < NUM_PERF_PHASES; p++){
+        for(int c = 0; c < NUM_PERF_COUNTERS; c++){log->perf.counts[p][c] += search_stats.perf.counts[p][c];}
+    }
+    return 1;
+}
+
+static GameResult bench_game(const BenchConfig* config, uint64_t seed, MoveLog* log){
+    // play_game, timing every move
+    double params[MAX_PARAMS];
+    memcpy(params, config->params, sizeof(params));
+    GameState game;
+    game_start(&game, seed);
+    BenchGame bench = {log, rollout_steps};
+    play_game_from(&game, config->engine, params, bench_hook, &bench);
+    return (GameResult){game.board.score, max_tile(&game.board), game.turns};
+}
+
+static void* bench_worker(void* arg){
+    BenchWorker* worker = arg;
+    BenchJob* job = worker->job;
+    while(true){
+        int g = __atomic_fetch_add(&job->next_game, 1, __ATOMIC_RELAXED);
+        if(g >= job->num_games){break;}
+        job->results[g] = bench_game(job->config, job->seed + g, &job->logs[worker->thread]);
+    }
+    return NULL;
+}
+
+static double run_games(BenchJob* job, int num_threads){
+    // plays every game of job on num_threads threads, returns the wall time in seconds
+    job->next_game = 0;
+    for(int t = 0; t < num_threads; t++){
+        free(job->logs[t].latencies);
+        job->logs[t] = (MoveLog){0};
+    }
+    double start = now_us();
+    pthread_t threads[num_threads];
+    BenchWorker workers[num_threads];
+    int started = 0;
+    for(int t = 1; t < num_threads; t++){
+        workers[t] = (BenchWorker){job, t};
+        if(pthread_create(&threads[t], NULL, bench_worker, &workers[t]) == 0){started = t;}
+    }
+    workers[0] = (BenchWorker){job, 0};
+    bench_worker(&workers[0]);
+    for(int t = 1; t <= started; t++){
+        pthread_join(threads[t], NULL);
+    }
+    return (now_us() - start) * 1e-6;
+}
+
+static int compare_doubles(const void* a, const void* b){
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double* sorted, long long n, double p){
+    // nearest rank
+    if(n == 0){return 0;}
+    long long rank = (long long)ceil(p / 100 * n);
+    return sorted[(rank < 1 ? 1 : rank) - 1];
+}
+
+static void write_config(FILE* out, const BenchConfig* config, uint64_t seed, int num_games, int* thread_counts, int num_counts){
+    BenchJob job = {config, seed, num_games, 0, NULL, NULL};
+    job.results = calloc(num_games, sizeof(GameResult));
+    int max_threads = thread_counts[num_counts - 1];
+    job.logs = calloc(max_threads, sizeof(MoveLog));
+
+    double seconds[num_counts];
+    long long moves[num_counts];
+    MoveLog single = {0};
+    double scores[num_games];
+    GameResult results[num_games];
+    for(int c = 0; c < num_counts; c++){
+        seconds[c] = run_games(&job, thread_counts[c]);
+        moves[c] = 0;
+        for(int t = 0; t < thread_counts[c]; t++){moves[c] += job.logs[t].num_moves;}
+        if(c == 0){
+            // keep the one thread run, the later runs only measure throughput
+            single = job.logs[0];
+            job.logs[0] = (MoveLog){0};
+            memcpy(results, job.results, sizeof(results));
+        }
+        fprintf(stderr, "%s: %d thread%s %.2fs\n", config->name, thread_counts[c], thread_counts[c] > 1 ? "s" : "", seconds[c]);
+    }
+
+    qsort(single.latencies, single.num_moves, sizeof(double), compare_doubles);
+    double score_sum = 0, score_sq = 0;
+    for(int g = 0; g < num_games; g++){
+        scores[g] = results[g].score;
+        score_sum += scores[g];
+    }
+    double mean = score_sum / num_games;
+    for(int g = 0; g < num_games; g++){score_sq += (scores[g] - mean) * (scores[g] - mean);}
+    qsort(scores, num_games, sizeof(double), compare_doubles);
+
+    fprintf(out, "    {\"name\": \"%s\", \"engine\": \"%s\", \"params\": [", config->name, engine_name(config->engine));
+    for(int p = 0; p < config->num_params; p++){
+        fprintf(out, "%s%.17g", p ? ", " : "", config->params[p]);
+    }
+    fprintf(out, "],\n     \"moves\": %lld,\n", single.num_moves);
+    fprintf(out, "     \"latency_us\": {\"mean\": %.3f, \"p50\": %.3f, \"p90\": %.3f, \"p99\": %.3f, \"max\": %.3f},\n",
+        single.num_moves ? single.search_us / single.num_moves : 0, percentile(single.latencies, single.num_moves, 50),
+        percentile(single.latencies, single.num_moves, 90), percentile(single.latencies, single.num_moves, 99),
+        percentile(single.latencies, single.num_moves, 100));
+    double search_s = single.search_us * 1e-6;
+    fprintf(out, "     \"nodes\": %lld, \"nodes_per_s\": %.1f, \"rollout_steps_per_s\": %.1f,\n", single.nodes,
+        search_s > 0 ? single.nodes / search_s : 0, search_s > 0 ? single.rollout_steps / search_s : 0);
+    fprintf(out, "     \"score\": {\"mean\": %.3f, \"std\": %.3f, \"min\": %.0f, \"p10\": %.0f, \"p50\": %.0f, \"p90\": %.0f, \"max\": %.0f},\n",
+        mean, num_games > 1 ? sqrt(score_sq / (num_games - 1)) : 0, scores[0], percentile(scores, num_games, 10),
+        percentile(scores, num_games, 50), percentile(scores, num_games, 90), scores[num_games - 1]);
+
+    fprintf(out, "     \"tile_rates\": {");
+    for(int tile = 512; tile <= 16384; tile *= 2){
+        int reached = 0;
+        for(int g = 0; g < num_games; g++){reached += results[g].max_tile >= tile;}
+        fprintf(out, "%s\"%d\": %.4f", tile > 512 ? ", " : "", tile, (double)reached / num_games);
+    }
+    fprintf(out, "},\n     \"max_tiles\": {");
+    bool first = true;
+    for(int tile = 2; tile <= 65536; tile *= 2){
+        int count = 0;
+        for(int g = 0; g < num_games; g++){count += results[g].max_tile == tile;}
+        if(count){
+            fprintf(out, "%s\"%d\": %d", first ? "" : ", ", tile, count);
+            first = false;
+        }
+    }
+    // one thread plays every game, so its wall time is the core time
+    fprintf(out, "},\n     \"score_per_core_second\": %.3f,\n     \"scaling\": [", seconds[0] > 0 ? score_sum / seconds[0] : 0);
+    for(int c = 0; c < num_counts; c++){
+        double speedup = seconds[c] > 0 ? seconds[0] / seconds[c] : 0;
+        fprintf(out, "%s\n       {\"threads\": %d, \"seconds\": %.3f, \"moves_per_s\": %.1f, \"speedup\": %.3f, \"efficiency\": %.3f}",
+            c ? "," : "", thread_counts[c], seconds[c], seconds[c] > 0 ? moves[c] / seconds[c] : 0, speedup, speedup / thread_counts[c]);
+    }
+    fprintf(out, "]");
+    if(perf_level != PERF_OFF){
+        static const char* phase_names[NUM_PERF_PHASES] = {"search", "leaves", "rollouts"};
+        fprintf(out, ",\n     \"perf\": {");
+        for(int p = 0; p < NUM_PERF_PHASES; p++){
+            fprintf(out, "%s\"%s\": {", p ? ", " : "", phase_names[p]);
+            bool first_counter = true;
+            for(int c = 0; c < NUM_PERF_COUNTERS; c++){
+                if(!(single.perf.available & (1u << c))){continue;}
+                fprintf(out, "%s\"%s\": %llu", first_counter ? "" : ", ", perf_counter_name(c), (unsigned long long)single.perf.counts[p][c]);
+                first_counter = false;
+            }
+            fprintf(out, "}");
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "}");
+
+    free(single.latencies);
+    for(int t = 0; t < max_threads; t++){free(job.logs[t].latencies);}
+    free(job.logs);
+    free(job.results);
+}
+
+static bool parse_config(char* arg, BenchConfig* config){
+    // engine:p0,p1,... eg. packed:4,10.28,0,4.48
+    char* colon = strchr(arg, ':');
+    if(colon == NULL){return 0;}
+    *colon = 0;
+    config->name = arg;
+    config->engine = engine_by_name(arg);
+    if(config->engine < 0){return 0;}
+    config->num_params = 0;
+    memset(config->params, 0, sizeof(config->params));
+    for(char* p = strtok(colon + 1, ","); p != NULL && config->num_params < MAX_PARAMS; p = strtok(NULL, ",")){
+        config->params[config->num_params++] = atof(p);
+    }
+    return config->num_params > 0;
+}
+
+int main(int argc, char** argv){
+    int num_games = 4;
+    uint64_t seed = 1;
+    int max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* out_path = NULL;
+    const char* label = "";
+    int rollout_threads = 1;
+    int opt;
+    while((opt = getopt(argc, argv, "g:s:t:o:l:pr:")) != -1){
+        switch(opt){
+            case 'g': num_games = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            case 't': max_threads = atoi(optarg); break;
+            case 'o': out_path = optarg; break;
+            case 'l': label = optarg; break;
+            case 'p':
+                if(!perf_enable(PERF_PHASES)){fprintf(stderr, "no counters available, perf_event_open failed\n");}
+                break;
+            case 'r': rollout_threads = rollout_pool_init(atoi(optarg)); break;
+            default:
+                fprintf(stderr,
+                    "usage: %s [-g games] [-s seed] [-t max_threads] [-o out.json] [-l label] [-p] [-r rollout_threads] [engine:p0,p1,... ...]\n"
+                    "  -p counts cycles, cache and branch misses per phase of the search (perf.c)\n"
+                    "  -r plays the rollouts of each move on a pool of threads (pool.c), 0 for one per core\n"
+                    "  engines: expectimax, expectimax1, mcts, mcts2, packed, packed_pruned, ... (see game.c)\n"
+                    "  without engines a default set is run\n", argv[0]);
+                return 2;
+        }
+    }
+    if(num_games < 1 || max_threads < 1){
+        fprintf(stderr, "games and max_threads must be positive\n");
+        return 2;
+    }
+
+    BenchConfig configs[MAX_CONFIGS];
+    int num_configs = 0;
+    for(int a = optind; a < argc && num_configs < MAX_CONFIGS; a++){
+        if(!parse_config(argv[a], &configs[num_configs])){
+            fprintf(stderr, "bad engine configuration %s\n", argv[a]);
+            return 2;
+        }
+        num_configs++;
+    }
+    if(num_configs == 0){
+        num_configs = sizeof(default_configs) / sizeof(default_configs[0]);
+        memcpy(configs, default_configs, sizeof(default_configs));
+    }
+
+    FILE* out = (out_path != NULL) ? fopen(out_path, "w") : stdout;
+    if(out == NULL){
+        fprintf(stderr, "could not open %s\n", out_path);
+        return 1;
+    }
+
+    // 1, 2, 4, ... up to max_threads, always ending with max_threads
+    int thread_counts[32];
+    int num_counts = 0;
+    for(int t = 1; t < max_threads && num_counts < 31; t *= 2){thread_counts[num_counts++] = t;}
+    thread_counts[num_counts++] = max_threads;
+
+    fprintf(out, "{\"schema\": \"twency48-bench\", \"version\": %d, \"label\": \"%s\", \"seed\": %llu, \"games\": %d,\n \"threads\": [",
+        BENCH_SCHEMA_VERSION, label, (unsigned long long)seed, num_games);
+    for(int c = 0; c < num_counts; c++){fprintf(out, "%s%d", c ? ", " : "", thread_counts[c]);}
+    fprintf(out, "], \"rollout_threads\": %d,\n \"engines\": [\n", rollout_threads);
+    for(int i = 0; i < num_configs; i++){
+        int counts = engine_is_threadsafe(configs[i].engine) ? num_counts : 1;
+        write_config(out, &configs[i], seed, num_games, thread_counts, counts);
+        fprintf(out, "%s\n", i + 1 < num_configs ? "," : "");
+        fflush(out);
+    }
+    fprintf(out, " ]}\n");
+    if(out != stdout){fclose(out);}
+    return 0;
+}
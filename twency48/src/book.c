@@ -0,0 +1,296 @@
+#include <pthread.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "twency48.h"
+
+// Opening book
+// book_build plays seeded self-play games with one engine configuration and records the move the
+// engine chose for each of the first positions of every game, with the mean final score of the games
+// that reached it. The book file is a header followed by BookEntry records sorted by packed board,
+// so book_open maps it and lookups are a binary search. engine_move answers from the open book when
+// the engine and params are the ones it was built with.
+// Positions are keyed by the exact packed board, not a canonical one over the 8 symmetries: the
+// evaluators follow a snake path into tile 15, so the engine's move on a mirrored board is not the
+// mirror of its move.
+// Keys leave out the score. A board reached with another score than in self-play gets the self-play
+// move, which can differ from the engine's: with a loss penalty (params[2]) the clamped values do not
+// scale with the score. In the opening, where the book is used, scores along different paths to a
+// board are close.
+
+#define BOOK_MAGIC "T48BOOK1"
+#define BOOK_VERSION 1
+#define BOOK_MAX_PARAMS 8
+
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t item_size;     // sizeof(BookEntry)
+    uint64_t num_entries;
+    int32_t engine;         // Engine the book was built with
+    int32_t num_params;
+    double params[BOOK_MAX_PARAMS];
+} BookFileHeader;
+
+typedef struct{
+    int engine;
+    double* params;
+    int num_params;
+    uint64_t seed;
+    int num_games;
+    int max_plies;
+    BookEntry* entries;     // max_plies per game
+    int* num_entries;       // entries recorded per game
+    int next_game;          // shared counter, taken with __atomic_fetch_add
+} BookJob;
+
+static BookFileHeader book_header;
+static const BookEntry* book_entries = NULL;
+static size_t book_mapped_size = 0;
+static long long book_lookups = 0;
+static long long book_hits = 0;
+
+static const BookEntry* book_find(uint64_t board){
+    uint64_t lo = 0, hi = book_header.num_entries;
+    while(lo < hi){
+        uint64_t mid = lo + (hi - lo) / 2;
+        if(book_entries[mid].board < board){
+            lo = mid + 1;
+        }else{
+            hi = mid;
+        }
+    }
+    return (lo < book_header.num_entries && book_entries[lo].board == board) ? &book_entries[lo] : NULL;
+}
+
+static bool read_header(const char* path, BookFileHeader* header){
+    FILE* file = fopen(path, "rb");
+    if(file == NULL){return 0;}
+    bool ok = fread(header, sizeof(*header), 1, file) == 1;
+    fclose(file);
+    return ok && memcmp(header->magic, BOOK_MAGIC, 8) == 0 && header->version == BOOK_VERSION
+        && header->item_size == sizeof(BookEntry) && header->num_params <= BOOK_MAX_PARAMS;
+}
+
+void book_close(){
+    if(book_entries != NULL){
+        munmap((char*)book_entries - sizeof(BookFileHeader), book_mapped_size);
+    }
+    book_entries = NULL;
+    book_header.num_entries = 0;
+}
+
+long long book_open(const char* path){
+    /*maps the book at path, replacing the open one, so engine_move answers from it
+     not thread safe, open it before starting searches
+     returns the number of positions in the book, -1 if path is not a book
+    */
+    book_close();
+    BookFileHeader header;
+    if(!read_header(path, &header)){return -1;}
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){return -1;}
+    struct stat st;
+    size_t size = sizeof(BookFileHeader) + header.num_entries * sizeof(BookEntry);
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < size){
+        close(fd);
+        return -1;
+    }
+    void* mapped = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){return -1;}
+    book_header = header;
+    book_entries = (const BookEntry*)((char*)mapped + sizeof(BookFileHeader));
+    book_mapped_size = size;
+    return header.num_entries;
+}
+
+bool book_accepts(int engine, double* params, int num_params){
+    // 1 if the open book was built with engine and params, params past num_params count as 0
+    if(book_entries == NULL || engine != book_header.engine){return 0;}
+    for(int i = 0; i < book_header.num_params; i++){
+        if(((i < num_params) ? params[i] : 0) != book_header.params[i]){return 0;}
+    }
+    return 1;
+}
+
+int book_move(int engine, int* tiles, int score, double* params, int num_params){
+    // book_engine_move for tiles in int rep, for callers without a Board (ExpectiMax7)
+    if(!book_accepts(engine, params, num_params)){return -1;}
+    Board b;
+    intrep_to_powerrep(b.tiles, tiles);
+    b.score = score;
+    return book_engine_move(engine, &b, params);
+}
+
+int book_engine_move(int engine, Board* board, double* params){
+    // the book's move for board if the book was built with engine and params, -1 otherwise
+    if(!book_accepts(engine, params, book_header.num_params)){return -1;}
+    uint64_t packed;
+    if(!pack_board(board, &packed)){return -1;}
+    __atomic_add_fetch(&book_lookups, 1, __ATOMIC_RELAXED);
+    const BookEntry* entry = book_find(packed);
+    if(entry == NULL){return -1;}
+    __atomic_add_fetch(&book_hits, 1, __ATOMIC_RELAXED);
+    search_stats = (SearchStats){0};
+    return entry->move;
+}
+
+void book_get_stats(long long* lookups, long long* hits){
+    // lookups made by engine_move since the start of the process and how many the book answered
+    *lookups = __atomic_load_n(&book_lookups, __ATOMIC_RELAXED);
+    *hits = __atomic_load_n(&book_hits, __ATOMIC_RELAXED);
+}
+
+typedef struct{
+    const BookJob* job;
+    BookEntry* entries;
+    int num_entries;
+} SelfPlay;
+
+static bool record_hook(void* context, const GameState* game, const Board* before, int move, int spawn_cell, int spawn_value, double search_us){
+    SelfPlay* play = context;
+    uint64_t packed;
+    if(play->num_entries < play->job->max_plies && pack_board((Board*)before, &packed)){
+        play->entries[play->num_entries++] = (BookEntry){packed, 0, 1, move};
+    }
+    return 1;
+}
+
+static int self_play(BookJob* job, uint64_t seed, BookEntry* entries){
+    // plays one seeded game as play_game does, without the book, recording its first max_plies positions
+    // returns the number recorded
+    double params[BOOK_MAX_PARAMS] = {0};
+    memcpy(params, job->params, job->num_params * sizeof(double));
+    GameState game;
+    game_start(&game, seed);
+    game.skip_book = 1;
+    SelfPlay play = {job, entries, 0};
+    play_game_from(&game, job->engine, params, record_hook, &play);
+    for(int i = 0; i < play.num_entries; i++){
+        entries[i].value = game.board.score;
+    }
+    return play.num_entries;
+}
+
+static void* book_worker(void* arg){
+    BookJob* job = arg;
+    while(true){
+        int g = __atomic_fetch_add(&job->next_game, 1, __ATOMIC_RELAXED);
+        if(g >= job->num_games){break;}
+        job->num_entries[g] = self_play(job, job->seed + g, job->entries + (size_t)g * job->max_plies);
+    }
+    return NULL;
+}
+
+static int compare_entries(const void* a, const void* b){
+    uint64_t x = ((const BookEntry*)a)->board;
+    uint64_t y = ((const BookEntry*)b)->board;
+    return (x > y) - (x < y);
+}
+
+static uint64_t merge_entries(BookEntry* entries, uint64_t n){
+    // sorts entries and merges repeated positions, returns the number left
+    qsort(entries, n, sizeof(BookEntry), compare_entries);
+    uint64_t out = 0;
+    for(uint64_t i = 0; i < n; i++){
+        if(out > 0 && entries[out-1].board == entries[i].board){
+            BookEntry* e = &entries[out-1];
+            uint64_t count = (uint64_t)e->count + entries[i].count;
+            e->value = (e->value * e->count + entries[i].value * entries[i].count) / count;
+            e->count = (count > UINT32_MAX) ? UINT32_MAX : count;
+        }else{
+            entries[out++] = entries[i];
+        }
+    }
+    return out;
+}
+
+long long book_build(const char* path, int engine, double* params, int num_params, uint64_t seed, int num_games, int max_plies, int num_threads, long long* positions){
+    /*plays num_games self-play games with engine and params (seeds seed, seed+1, ...) and adds the first
+     max_plies positions of each to the book at path, creating it if needed
+        num_params: params the book is keyed on, at most 8
+        num_threads: 0 for one per core, engines that keep state between calls are run on one thread
+        positions: set to the number of positions recorded by this run
+     the book is written to path.tmp and renamed over path, so a book open in this or another process
+     keeps working
+     returns the number of positions in the book, -1 if engine is not valid, the book at path was built
+     with another engine or params, or it could not be written
+    */
+    if(engine_function(engine) == NULL || num_params < 1 || num_params > BOOK_MAX_PARAMS || num_games < 1 || max_plies < 1){return -1;}
+    BookFileHeader header = {BOOK_MAGIC, BOOK_VERSION, sizeof(BookEntry), 0, engine, num_params, {0}};
+    memcpy(header.params, params, num_params * sizeof(double));
+
+    BookFileHeader existing;
+    uint64_t num_existing = 0;
+    if(access(path, F_OK) == 0){
+        if(!read_header(path, &existing) || existing.engine != engine || existing.num_params != num_params
+            || memcmp(existing.params, header.params, sizeof(header.params)) != 0){
+            return -1;
+        }
+        num_existing = existing.num_entries;
+    }
+
+    BookJob job = {0};
+    job.engine = engine;
+    job.params = params;
+    job.num_params = num_params;
+    job.seed = seed;
+    job.num_games = num_games;
+    job.max_plies = max_plies;
+    job.entries = malloc((num_existing + (size_t)num_games * max_plies) * sizeof(BookEntry));
+    job.num_entries = calloc(num_games, sizeof(int));
+    if(job.entries == NULL || job.num_entries == NULL){
+        free(job.entries);
+        free(job.num_entries);
+        return -1;
+    }
+
+    if(num_threads <= 0){num_threads = sysconf(_SC_NPROCESSORS_ONLN);}
+    if(!engine_is_threadsafe(engine)){num_threads = 1;}
+    pthread_t threads[num_threads];
+    int started = 0;
+    for(int t = 0; t < num_threads; t++){
+        if(pthread_create(&threads[t], NULL, book_worker, &job) == 0){started++;}
+    }
+    if(!started){book_worker(&job);}
+    for(int t = 0; t < started; t++){
+        pthread_join(threads[t], NULL);
+    }
+
+    // compact the games' entries, then add the existing book after them
+    uint64_t n = 0;
+    for(int g = 0; g < num_games; g++){
+        memmove(job.entries + n, job.entries + (size_t)g * max_plies, job.num_entries[g] * sizeof(BookEntry));
+        n += job.num_entries[g];
+    }
+    *positions = n;
+    if(num_existing){
+        FILE* file = fopen(path, "rb");
+        bool ok = file != NULL && fseek(file, sizeof(BookFileHeader), SEEK_SET) == 0
+            && fread(job.entries + n, sizeof(BookEntry), num_existing, file) == num_existing;
+        if(file != NULL){fclose(file);}
+        if(!ok){
+            free(job.entries);
+            free(job.num_entries);
+            return -1;
+        }
+        n += num_existing;
+    }
+    header.num_entries = merge_entries(job.entries, n);
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+    FILE* out = fopen(tmp_path, "wb");
+    bool written = out != NULL && fwrite(&header, sizeof(header), 1, out) == 1
+        && fwrite(job.entries, sizeof(BookEntry), header.num_entries, out) == header.num_entries;
+    if(out != NULL && fclose(out) != 0){written = 0;}
+    free(job.entries);
+    free(job.num_entries);
+    if(!written || rename(tmp_path, path) != 0){
+        unlink(tmp_path);
+        return -1;
+    }
+    return header.num_entries;
+}
@@ -0,0 +1,82 @@
+#include <string.h>
+#include "twency48.h"
+
+// command line front end for book_build
+
+#define MAX_PARAMS 8
+
+int main(int argc, char** argv){
+    int num_games = 100;
+    uint64_t seed = 1;
+    int max_plies = 300;
+    int num_threads = 0;
+    int check_games = 0;
+    int opt;
+    while((opt = getopt(argc, argv, "g:s:m:t:c:")) != -1){
+        switch(opt){
+            case 'g': num_games = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            case 'm': max_plies = atoi(optarg); break;
+            case 't': num_threads = atoi(optarg); break;
+            case 'c': check_games = atoi(optarg); break;
+            default:
+                fprintf(stderr,
+                    "usage: %s [-g games] [-s seed] [-m max_plies] [-t threads] [-c check_games] book engine:p0,p1,...\n"
+                    "  adds the first max_plies positions of games seeded seed, seed+1, ... to book\n"
+                    "  rerun with other seeds and the same engine and params to grow it\n"
+                    "  -c plays check_games more games after the built ones with the book and reports how many moves it answered\n", argv[0]);
+                return 2;
+        }
+    }
+    if(argc - optind != 2 || num_games < 1 || max_plies < 1){
+        fprintf(stderr, "usage: %s [-g games] [-s seed] [-m max_plies] [-t threads] [-c check_games] book engine:p0,p1,...\n", argv[0]);
+        return 2;
+    }
+    const char* path = argv[optind];
+    char* config = argv[optind + 1];
+    char* colon = strchr(config, ':');
+    int engine = -1;
+    double params[MAX_PARAMS] = {0};
+    int num_params = 0;
+    if(colon != NULL){
+        *colon = 0;
+        engine = engine_by_name(config);
+        for(char* p = strtok(colon + 1, ","); p != NULL && num_params < MAX_PARAMS; p = strtok(NULL, ",")){
+            params[num_params++] = atof(p);
+        }
+    }
+    if(engine < 0 || num_params == 0){
+        fprintf(stderr, "bad engine configuration %s\n", argv[optind + 1]);
+        return 2;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long positions = 0;
+    long long entries = book_build(path, engine, params, num_params, seed, num_games, max_plies, num_threads, &positions);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if(entries < 0){
+        fprintf(stderr, "could not build %s, an existing book must have the same engine and params\n", path);
+        return 1;
+    }
+    printf("positions recorded: %lld\n", positions);
+    printf("book positions: %lld\n", entries);
+    printf("time: %.2fs\n", (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9);
+
+    if(check_games > 0){
+        if(book_open(path) < 0){
+            fprintf(stderr, "could not open %s\n", path);
+            return 1;
+        }
+        GameResult* results = malloc(check_games * sizeof(GameResult));
+        play_games(engine, params, seed + num_games, check_games, NULL, results);
+        long long lookups, hits, turns = 0;
+        book_get_stats(&lookups, &hits);
+        for(int g = 0; g < check_games; g++){turns += results[g].turns;}
+        printf("check games: %d, turns %lld, answered by the book %lld (%.2f%%)\n",
+            check_games, turns, hits, turns ? 100.0 * hits / turns : 0.0);
+        free(results);
+        book_close();
+    }
+    return 0;
+}
@@ -0,0 +1,233 @@
+#include <string.h>
+#include "packed.h"
+
+// Breadth first state enumeration
+// enumerate_states expands a packed board a ply at a time, alternating spawn plies (every empty
+// cell with a 2 or a 4, at their real probabilities) and move plies (every valid move with equal
+// probability, or the greedy move of rollout.c). Each ply is built into a hash set keyed by board, so
+// a state reached along several paths is kept once with the sum of their probabilities and their
+// probability weighted mean score. The frontier is kept as columns (boards, probs, scores), which
+// Enumerate.py wraps as numpy arrays without copying.
+// max_states and min_prob cap each ply: states below min_prob are dropped, then the least likely
+// states until max_states are left, and the mass dropped is added to dropped_mass, as is that of
+// children which cannot be packed (moves merging two 32768s).
+
+typedef struct{
+    uint64_t* keys;             // board + 1, 0 for an empty slot
+    uint32_t* slots;            // index of the board in the columns
+    uint64_t mask;
+} StateSet;
+
+static bool grow_frontier(Frontier* f, uint64_t capacity){
+    if(capacity <= f->capacity){return 1;}
+    uint64_t* boards = realloc(f->boards, capacity * sizeof(uint64_t));
+    if(boards != NULL){f->boards = boards;}
+    double* probs = realloc(f->probs, capacity * sizeof(double));
+    if(probs != NULL){f->probs = probs;}
+    double* scores = realloc(f->scores, capacity * sizeof(double));
+    if(scores != NULL){f->scores = scores;}
+    if(boards == NULL || probs == NULL || scores == NULL){return 0;}
+    f->capacity = capacity;
+    return 1;
+}
+
+void frontier_free(Frontier* f){
+    free(f->boards);
+    free(f->probs);
+    free(f->scores);
+    *f = (Frontier){0};
+}
+
+static bool set_init(StateSet* set, uint64_t max_entries){
+    // sized for a load factor of at most 1/2
+    uint64_t size = 16;
+    while(size < 2 * max_entries){size *= 2;}
+    set->keys = calloc(size, sizeof(uint64_t));
+    set->slots = malloc(size * sizeof(uint32_t));
+    set->mask = size - 1;
+    return set->keys != NULL && set->slots != NULL;
+}
+
+static void set_free(StateSet* set){
+    free(set->keys);
+    free(set->slots);
+}
+
+static inline void add_state(Frontier* f, StateSet* set, uint64_t board, double prob, double score){
+    // merges board into the frontier being built, f must have room for one more state
+    uint64_t h = (board * 0x9e3779b97f4a7c15ULL) >> 20;
+    while(true){
+        uint64_t i = h & set->mask;
+        if(set->keys[i] == 0){
+            set->keys[i] = board + 1;
+            set->slots[i] = f->count;
+            f->boards[f->count] = board;
+            f->probs[f->count] = prob;
+            f->scores[f->count] = score;
+            f->count++;
+            return;
+        }
+        if(set->keys[i] == board + 1){
+            uint32_t s = set->slots[i];
+            double total = f->probs[s] + prob;
+            f->scores[s] = (f->scores[s] * f->probs[s] + score * prob) / total;
+            f->probs[s] = total;
+            return;
+        }
+        h++;
+    }
+}
+
+static bool expand_ply(Frontier* from, Frontier* to, int ply, int move_policy, double* params, uint64_t* expanded, double* dropped){
+    // builds the next ply of from into to, boards without a valid move are carried over unchanged
+    // expanded is set to the number of boards that had children, dropped to the probability of the
+    // children that cannot be packed (a move merging two 32768s)
+    to->count = 0;
+    *expanded = 0;
+    *dropped = 0;
+    // at most 30 spawns or 4 moves per state
+    uint64_t max_children = from->count * ((ply == ENUM_SPAWN) ? 30 : 4);
+    StateSet set;
+    if(!grow_frontier(to, max_children) || !set_init(&set, max_children)){return 0;}
+    for(uint64_t s = 0; s < from->count; s++){
+        uint64_t board = from->boards[s];
+        double prob = from->probs[s];
+        double score = from->scores[s];
+        if(ply == ENUM_SPAWN){
+            int empty = count_empty_packed(board);
+            if(!empty){
+                add_state(to, &set, board, prob, score);
+                continue;
+            }
+            (*expanded)++;
+            for(int i = 0; i < 16; i++){
+                if((board >> (4*i)) & 0xF){continue;}
+                add_state(to, &set, board | (1ULL << (4*i)), prob * 0.9 / empty, score);
+                add_state(to, &set, board | (2ULL << (4*i)), prob * 0.1 / empty, score);
+            }
+        }else{
+            uint64_t children[4];
+            int gains[4];
+            int n = 0;
+            int unpackable = 0;
+            int greedy = (move_policy == ENUM_MOVES_GREEDY) ? greedy_move_packed(board, params) : -1;
+            for(int m = 0; m < 4; m++){
+                if(move_policy == ENUM_MOVES_GREEDY && m != greedy){continue;}
+                if(move_unpackable_packed(board, m)){
+                    unpackable++;
+                    continue;
+                }
+                int gained = 0;
+                uint64_t child = apply_move_packed(board, m, &gained);
+                if(child == board){continue;}
+                children[n] = child;
+                gains[n++] = gained;
+            }
+            if(!n && !unpackable){
+                add_state(to, &set, board, prob, score);
+                continue;
+            }
+            (*expanded)++;
+            for(int i = 0; i < n; i++){
+                add_state(to, &set, children[i], prob / (n + unpackable), score + gains[i]);
+            }
+            *dropped += prob * unpackable / (n + unpackable);
+        }
+    }
+    set_free(&set);
+    return 1;
+}
+
+static int compare_prob_desc(const void* a, const void* b){
+    double x = ((const double*)a)[1], y = ((const double*)b)[1];
+    return (x < y) - (x > y);
+}
+
+static void apply_caps(Frontier* f, uint64_t max_states, double min_prob){
+    uint64_t kept = 0;
+    for(uint64_t s = 0; s < f->count; s++){
+        if(f->probs[s] < min_prob){
+            f->dropped_mass += f->probs[s];
+            continue;
+        }
+        f->boards[kept] = f->boards[s];
+        f->probs[kept] = f->probs[s];
+        f->scores[kept] = f->scores[s];
+        kept++;
+    }
+    f->count = kept;
+    if(max_states == 0 || f->count <= max_states){return;}
+
+    // keep the max_states most likely, sorting (index, prob) pairs rather than the three columns
+    double (*order)[2] = malloc(f->count * sizeof(*order));
+    if(order == NULL){return;}
+    for(uint64_t s = 0; s < f->count; s++){
+        order[s][0] = s;
+        order[s][1] = f->probs[s];
+    }
+    qsort(order, f->count, sizeof(*order), compare_prob_desc);
+    for(uint64_t s = max_states; s < f->count; s++){
+        f->dropped_mass += order[s][1];
+    }
+    // gather the kept states in their original order, so the result does not depend on the sort
+    bool* keep = calloc(f->count, sizeof(bool));
+    if(keep == NULL){free(order); return;}
+    for(uint64_t s = 0; s < max_states; s++){keep[(uint64_t)order[s][0]] = 1;}
+    kept = 0;
+    for(uint64_t s = 0; s < f->count; s++){
+        if(!keep[s]){continue;}
+        f->boards[kept] = f->boards[s];
+        f->probs[kept] = f->probs[s];
+        f->scores[kept] = f->scores[s];
+        kept++;
+    }
+    f->count = kept;
+    free(keep);
+    free(order);
+}
+
+int enumerate_states(Frontier* frontier, uint64_t board, int score, int first_ply, int num_plies, int move_policy, double* params, uint64_t max_states, double min_prob){
+    /*expands board (packed) num_plies plies, starting with a spawn ply (ENUM_SPAWN) or a move ply (ENUM_MOVE)
+        num_plies: plies to expand, -1 to keep expanding while the next ply fits in max_states uncapped,
+                   fewer are expanded once no state has a child
+        move_policy: one of EnumMovePolicy, params are used by ENUM_MOVES_GREEDY as in get_next_move ([1] and [3])
+        max_states: states kept per ply, 0 for no cap
+        min_prob: states less likely than this are dropped
+     frontier is replaced with the last ply, release it with frontier_free
+     returns the number of plies expanded, -1 if memory ran out
+    */
+    frontier_free(frontier);
+    if(num_plies < 0 && max_states == 0){return -1;}
+    if(!grow_frontier(frontier, 1)){return -1;}
+    move_tables_init();
+    frontier->boards[0] = board;
+    frontier->probs[0] = 1;
+    frontier->scores[0] = score;
+    frontier->count = 1;
+
+    Frontier next = {0};
+    int ply = first_ply;
+    int plies = 0;
+    while(num_plies < 0 || plies < num_plies){
+        uint64_t expanded;
+        double dropped;
+        if(!expand_ply(frontier, &next, ply, move_policy, params, &expanded, &dropped)){
+            frontier_free(&next);
+            return -1;
+        }
+        if(!expanded || (num_plies < 0 && next.count > max_states)){
+            // every game is over, or the next ply is over the cap
+            break;
+        }
+        next.dropped_mass = frontier->dropped_mass + dropped;
+        apply_caps(&next, max_states, min_prob);
+        Frontier done = *frontier;
+        *frontier = next;
+        next = done;
+        plies++;
+        ply = (ply == ENUM_SPAWN) ? ENUM_MOVE : ENUM_SPAWN;
+    }
+    frontier_free(&next);
+    frontier->plies = plies;
+    return plies;
+}
@@ -0,0 +1,291 @@
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include "twency48.h"
+
+// Checkpointed evaluation runs
+// run_evaluation plays the games of play_games (game g seeded seed+g) on several threads, and saves
+// the state of every game, finished or not, to a checkpoint file every checkpoint_s seconds and
+// whenever a game ends. Running it again with the same checkpoint, engine, params, seed and number
+// of games carries on from the saved states: finished games are not replayed and games in flight
+// continue from their last saved turn with the same spawn and rollout Rngs (see play_game_from), so
+// an interrupted run ends with the games an uninterrupted one would have (for engines that do not keep
+// state between calls).
+// The checkpoint is a header followed by one EvalGame per game, written to path.tmp, synced and
+// renamed over path, so a crash while writing leaves the previous checkpoint. The result line of a
+// game is appended to results_path once a checkpoint that has the game done is saved, so a resumed
+// run never plays it again after its line is written. On resume the lines already in results_path
+// are read, and games the checkpoint has done but results_path lacks (the process died between the
+// two writes) get their line then, so every game ends up with exactly one line.
+// evaluation_stop (from a signal handler, say) abandons the searches in progress, saves the
+// checkpoint and makes run_evaluation return; the interrupted moves are searched again on resume.
+
+#define EVAL_MAGIC "T48EVAL1"
+#define EVAL_VERSION 2     // 2 saves the rollout Rng
+#define EVAL_MAX_PARAMS 8
+
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t item_size;     // sizeof(EvalGame)
+    int32_t engine;
+    int32_t num_params;
+    double params[EVAL_MAX_PARAMS];
+    uint64_t seed;
+    int32_t num_games;
+    int32_t reserved;
+} EvalFileHeader;
+
+typedef struct{
+    EvalFileHeader header;
+    const char* path;
+    double* params;
+    EvalGame* games;        // guarded by lock
+    int next_game;          // shared counter, taken with __atomic_fetch_add
+    int running;            // workers still playing, guarded by lock
+    bool dirty;             // a game ended since the last checkpoint, guarded by lock
+    FILE* out;
+    bool* reported;         // games with a line in out, only used by the thread writing checkpoints
+    pthread_mutex_t lock;
+    pthread_cond_t wake;    // signalled when a game ends or a worker exits
+} EvalRun;
+
+static volatile int eval_stopping = 0;
+
+void evaluation_stop(){
+    // async signal safe
+    eval_stopping = 1;
+}
+
+static bool load_checkpoint(EvalRun* run){
+    // fills run->games from the checkpoint if there is one
+    // returns 0 if the file exists but is not a checkpoint of the same run
+    FILE* in = fopen(run->path, "rb");
+    if(in == NULL){return errno == ENOENT;}
+    EvalFileHeader header;
+    bool ok = fread(&header, sizeof(header), 1, in) == 1
+        && memcmp(&header, &run->header, sizeof(header)) == 0
+        && fread(run->games, sizeof(EvalGame), header.num_games, in) == (size_t)header.num_games;
+    fclose(in);
+    return ok;
+}
+
+static bool read_results(EvalRun* run, const char* results_path){
+    // marks the games that already have a line in results_path as reported
+    // returns 0 if the file ends in a line cut short, which write_checkpoint then ends before appending
+    FILE* in = fopen(results_path, "r");
+    if(in == NULL){return 1;}
+    char line[256];
+    bool ended = 1;
+    while(fgets(line, sizeof(line), in) != NULL){
+        ended = strchr(line, '\n') != NULL;
+        int g;
+        unsigned long long seed;
+        int score, tile, turns;
+        if(ended && sscanf(line, "%d,%llu,%d,%d,%d", &g, &seed, &score, &tile, &turns) == 5
+            && g >= 0 && g < run->header.num_games && seed == run->header.seed + g){
+            run->reported[g] = 1;
+        }
+    }
+    fclose(in);
+    return ended;
+}
+
+static void report_results(EvalRun* run, const EvalGame* games){
+    // appends the lines of the games done in games, a saved checkpoint, that are not reported yet
+    if(run->out == NULL){return;}
+    bool any = 0;
+    for(int g = 0; g < run->header.num_games; g++){
+        if(games[g].status != EVAL_DONE || run->reported[g]){continue;}
+        fprintf(run->out, "%d,%llu,%d,%d,%d\n", g, (unsigned long long)(run->header.seed + g), games[g].score, games[g].max_tile, games[g].turns);
+        run->reported[g] = 1;
+        any = 1;
+    }
+    if(any){fflush(run->out);}
+}
+
+static bool write_checkpoint(EvalRun* run){
+    // snapshot of every game, written next to the checkpoint and renamed over it
+    size_t size = run->header.num_games * sizeof(EvalGame);
+    EvalGame* snapshot = malloc(size);
+    if(snapshot == NULL){return 0;}
+    pthread_mutex_lock(&run->lock);
+    memcpy(snapshot, run->games, size);
+    run->dirty = 0;
+    pthread_mutex_unlock(&run->lock);
+
+    char tmp_path[4096];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", run->path);
+    FILE* out = fopen(tmp_path, "wb");
+    bool written = out != NULL
+        && fwrite(&run->header, sizeof(run->header), 1, out) == 1
+        && fwrite(snapshot, sizeof(EvalGame), run->header.num_games, out) == (size_t)run->header.num_games
+        && fflush(out) == 0 && fsync(fileno(out)) == 0;
+    if(out != NULL){written = (fclose(out) == 0) && written;}
+    if(!written || rename(tmp_path, run->path) != 0){
+        unlink(tmp_path);
+        free(snapshot);
+        return 0;
+    }
+    report_results(run, snapshot);
+    free(snapshot);
+    return 1;
+}
+
+typedef struct{
+    EvalRun* run;
+    int g;
+} EvalSlot;
+
+static void save_game(EvalRun* run, int g, const GameState* game){
+    EvalGame saved = {game->spawns.state, game->rollouts.state, {0}, game->board.score, game->turns, 0, EVAL_PLAYING};
+    memcpy(saved.tiles, game->board.tiles, 16);
+    if(game->over){
+        saved.max_tile = max_tile((Board*)&game->board);
+        saved.status = EVAL_DONE;
+    }
+    pthread_mutex_lock(&run->lock);
+    run->games[g] = saved;
+    if(game->over){
+        run->dirty = 1;
+        pthread_cond_signal(&run->wake);
+    }
+    pthread_mutex_unlock(&run->lock);
+}
+
+static bool save_hook(void* context, const GameState* game, const Board* before, int move, int spawn_cell, int spawn_value, double search_us){
+    EvalSlot* slot = context;
+    save_game(slot->run, slot->g, game);
+    return 1;
+}
+
+static void play_eval_game(EvalRun* run, int g){
+    pthread_mutex_lock(&run->lock);
+    EvalGame saved = run->games[g];
+    pthread_mutex_unlock(&run->lock);
+    GameState game;
+    if(saved.status == EVAL_PENDING){
+        game_start(&game, run->header.seed + g);
+    }else{
+        game = (GameState){{{0}, saved.score}, {saved.rng}, {saved.rollout_rng}, saved.turns, 0, 0};
+        memcpy(game.board.tiles, saved.tiles, 16);
+    }
+    EvalSlot slot = {run, g};
+    // every move is saved by the hook, a stopped game keeps the state after its last one
+    if(play_game_from(&game, run->header.engine, run->params, save_hook, &slot)){
+        save_game(run, g, &game);
+    }
+}
+
+static void* eval_worker(void* arg){
+    EvalRun* run = arg;
+    search_abort = &eval_stopping;
+    while(!eval_stopping){
+        int g = __atomic_fetch_add(&run->next_game, 1, __ATOMIC_RELAXED);
+        if(g >= run->header.num_games){break;}
+        if(run->games[g].status == EVAL_DONE){continue;}
+        play_eval_game(run, g);
+    }
+    search_abort = NULL;
+    pthread_mutex_lock(&run->lock);
+    run->running--;
+    pthread_cond_signal(&run->wake);
+    pthread_mutex_unlock(&run->lock);
+    return NULL;
+}
+
+int run_evaluation(const char* checkpoint_path, int engine, double* params, int num_params, uint64_t seed, int num_games, int num_threads, double checkpoint_s, const char* results_path, GameResult* results){
+    /*plays games seeded seed, seed+1, ... as play_games, resuming from checkpoint_path if it holds a checkpoint of the same run
+        num_params: at most 8
+        num_threads: worker threads, 0 for one per core, engines that keep state between calls run on one
+        checkpoint_s: seconds between checkpoints, a checkpoint is also written when a game ends
+        results_path: if not NULL, "game,seed,score,max_tile,turns" is appended for each game once a checkpoint
+            has it done, games with a line from an earlier run are not written again
+        results (num_games entries) may be NULL, games left unfinished by evaluation_stop are zeroed
+     returns the number of finished games, num_games unless the run was stopped, -1 if an argument is not valid,
+     checkpoint_path holds another run or could not be written, or results_path could not be opened
+    */
+    if(engine_function(engine) == NULL || num_games < 1 || num_params < 1 || num_params > EVAL_MAX_PARAMS){return -1;}
+    EvalRun run = {0};
+    memcpy(run.header.magic, EVAL_MAGIC, 8);
+    run.header.version = EVAL_VERSION;
+    run.header.item_size = sizeof(EvalGame);
+    run.header.engine = engine;
+    run.header.num_params = num_params;
+    memcpy(run.header.params, params, num_params * sizeof(double));
+    run.header.seed = seed;
+    run.header.num_games = num_games;
+    run.path = checkpoint_path;
+    run.params = run.header.params;     // padded with zeros, engines read up to params[6]
+    run.games = calloc(num_games, sizeof(EvalGame));
+    run.reported = calloc(num_games, sizeof(bool));
+    bool ok = run.games != NULL && run.reported != NULL && load_checkpoint(&run);
+    if(ok && results_path != NULL){
+        bool ended = read_results(&run, results_path);
+        run.out = fopen(results_path, "a");
+        ok = run.out != NULL;
+        if(ok && !ended){fputc('\n', run.out);}
+    }
+    // also writes the lines the last run did not get to
+    if(!ok || !write_checkpoint(&run)){
+        if(run.out != NULL){fclose(run.out);}
+        free(run.games);
+        free(run.reported);
+        return -1;
+    }
+    pthread_mutex_init(&run.lock, NULL);
+    pthread_cond_init(&run.wake, NULL);
+    eval_stopping = 0;
+
+    if(num_threads <= 0){num_threads = sysconf(_SC_NPROCESSORS_ONLN);}
+    if(!engine_is_threadsafe(engine)){num_threads = 1;}
+    pthread_t threads[num_threads];
+    pthread_mutex_lock(&run.lock);
+    for(int t = 0; t < num_threads; t++){
+        if(pthread_create(&threads[run.running], NULL, eval_worker, &run) == 0){run.running++;}
+    }
+    int started = run.running;
+    pthread_mutex_unlock(&run.lock);
+    if(!started){eval_worker(&run);}
+
+    // this thread writes the checkpoints while the workers play
+    struct timespec last;
+    clock_gettime(CLOCK_MONOTONIC, &last);
+    bool saved = 1;
+    pthread_mutex_lock(&run.lock);
+    while(run.running > 0){
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 1;   // evaluation_stop is noticed within a second
+        pthread_cond_timedwait(&run.wake, &run.lock, &deadline);
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double since = (now.tv_sec - last.tv_sec) + (now.tv_nsec - last.tv_nsec) * 1e-9;
+        if(run.dirty || since >= checkpoint_s){
+            pthread_mutex_unlock(&run.lock);
+            saved = write_checkpoint(&run) && saved;
+            last = now;
+            pthread_mutex_lock(&run.lock);
+        }
+    }
+    pthread_mutex_unlock(&run.lock);
+    for(int t = 0; t < started; t++){
+        pthread_join(threads[t], NULL);
+    }
+    saved = write_checkpoint(&run) && saved;
+
+    int finished = 0;
+    for(int g = 0; g < num_games; g++){
+        EvalGame* game = &run.games[g];
+        finished += game->status == EVAL_DONE;
+        if(results != NULL){
+            results[g] = (game->status == EVAL_DONE) ? (GameResult){game->score, game->max_tile, game->turns} : (GameResult){0, 0, 0};
+        }
+    }
+    if(run.out != NULL){fclose(run.out);}
+    pthread_cond_destroy(&run.wake);
+    pthread_mutex_destroy(&run.lock);
+    free(run.games);
+    free(run.reported);
+    return saved ? finished : -1;
+}
@@ -0,0 +1,85 @@
+#include <signal.h>
+#include <string.h>
+#include "twency48.h"
+
+// command line front end for run_evaluation, interrupting it (ctrl-c, or SIGTERM from a scheduler)
+// saves the checkpoint, and running the same command again resumes
+
+#define MAX_PARAMS 8
+
+static void on_signal(int sig){
+    evaluation_stop();
+}
+
+int main(int argc, char** argv){
+    int num_games = 100;
+    uint64_t seed = 1;
+    int num_threads = 0;
+    double interval = 60;
+    const char* results_path = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "g:s:t:i:o:")) != -1){
+        switch(opt){
+            case 'g': num_games = atoi(optarg); break;
+            case 's': seed = strtoull(optarg, NULL, 10); break;
+            case 't': num_threads = atoi(optarg); break;
+            case 'i': interval = atof(optarg); break;
+            case 'o': results_path = optarg; break;
+            default:
+                fprintf(stderr,
+                    "usage: %s [-g games] [-s seed] [-t threads] [-i checkpoint_s] [-o results.csv] checkpoint engine:p0,p1,...\n"
+                    "  plays games seeded seed, seed+1, ..., saving them to checkpoint every checkpoint_s seconds\n"
+                    "  and as each game ends, rerun the same command to resume\n"
+                    "  -o appends game,seed,score,max_tile,turns once for each game, after its end is checkpointed\n", argv[0]);
+                return 2;
+        }
+    }
+    if(argc - optind != 2 || num_games < 1){
+        fprintf(stderr, "usage: %s [-g games] [-s seed] [-t threads] [-i checkpoint_s] [-o results.csv] checkpoint engine:p0,p1,...\n", argv[0]);
+        return 2;
+    }
+    const char* path = argv[optind];
+    char* config = argv[optind + 1];
+    char* colon = strchr(config, ':');
+    int engine = -1;
+    double params[MAX_PARAMS] = {0};
+    int num_params = 0;
+    if(colon != NULL){
+        *colon = 0;
+        engine = engine_by_name(config);
+        for(char* p = strtok(colon + 1, ","); p != NULL && num_params < MAX_PARAMS; p = strtok(NULL, ",")){
+            params[num_params++] = atof(p);
+        }
+    }
+    if(engine < 0 || num_params == 0){
+        fprintf(stderr, "bad engine configuration %s\n", argv[optind + 1]);
+        return 2;
+    }
+
+    struct sigaction action = {0};
+    action.sa_handler = on_signal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    GameResult* results = malloc(num_games * sizeof(GameResult));
+    int finished = run_evaluation(path, engine, params, num_params, seed, num_games, num_threads, interval, results_path, results);
+    if(finished < 0){
+        fprintf(stderr, "could not run %s, an existing checkpoint must be of the same engine, params, seed and games\n", path);
+        free(results);
+        return 1;
+    }
+    double total = 0;
+    int reached_2048 = 0;
+    for(int g = 0; g < num_games; g++){
+        total += results[g].score;
+        reached_2048 += results[g].max_tile >= 2048;
+    }
+    printf("finished games: %d of %d\n", finished, num_games);
+    if(finished){
+        printf("mean score: %.1f\n", total / finished);
+        printf("2048 rate: %.3f\n", (double)reached_2048 / finished);
+    }
+    free(results);
+    // 3 tells a wrapper script the run was interrupted and should be started again
+    return (finished < num_games) ? 3 : 0;
+}
@@ -0,0 +1,159 @@
+#include <pthread.h>
+#include <string.h>
+#include "twency48.h"
+
+// Event trace
+// Searches and the Monte Carlo evaluators record what they are doing as small binary events
+// (EventRecord) instead of printing it. Each thread writes to its own ring buffer, so recording
+// never takes a lock or makes a system call; when a ring is full new events are dropped and counted.
+// events_drain moves everything recorded so far, from every thread, to a file that Events.py
+// converts to Chrome trace / Perfetto JSON.
+// Recording is off until events_enable(1), until then event_emit costs one branch.
+
+#define EVENT_MAGIC "T48EVNTS"
+#define EVENT_VERSION 1
+#define EVENT_RING_LOG2 14 // 16384 events, 512KB per thread
+#define EVENT_RING_SIZE (1 << EVENT_RING_LOG2)
+
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t item_size;     // sizeof(EventRecord)
+} EventFileHeader;
+
+typedef struct EventRing{
+    EventRecord events[EVENT_RING_SIZE];
+    uint64_t head;          // events written, only the owning thread writes it
+    uint64_t tail;          // events drained, only events_drain writes it
+    uint64_t dropped;
+    int in_use;             // 1 while a live thread owns the ring
+    uint16_t thread;
+    struct EventRing* next;
+} EventRing;
+
+volatile int events_enabled = 0;
+static EventRing* rings = NULL;         // every ring ever made, pushed without a lock
+static uint16_t num_rings = 0;
+static __thread EventRing* ring = NULL;
+static pthread_key_t ring_key;
+static pthread_once_t ring_key_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t drain_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void release_ring(void* owned){
+    // thread exit, the ring keeps its events until drained and can be taken by a new thread
+    __atomic_store_n(&((EventRing*)owned)->in_use, 0, __ATOMIC_RELEASE);
+}
+
+static void make_ring_key(){
+    pthread_key_create(&ring_key, release_ring);
+}
+
+static EventRing* claim_ring(){
+    // reuses the ring of a finished thread if there is one
+    pthread_once(&ring_key_once, make_ring_key);
+    EventRing* r;
+    for(r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL; r = r->next){
+        int free_ring = 0;
+        if(__atomic_compare_exchange_n(&r->in_use, &free_ring, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)){
+            break;
+        }
+    }
+    if(r == NULL){
+        r = calloc(1, sizeof(EventRing));
+        if(r == NULL){return NULL;}
+        r->in_use = 1;
+        r->thread = __atomic_fetch_add(&num_rings, 1, __ATOMIC_RELAXED);
+        r->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&rings, &r->next, r, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)){}
+    }
+    pthread_setspecific(ring_key, r);
+    return r;
+}
+
+void events_enable(int enable){
+    events_enabled = enable;
+}
+
+void event_record(int type, int arg, double value0, double value1){
+    // appends an event to the calling thread's ring, use event_emit so nothing is done while disabled
+    if(ring == NULL){
+        ring = claim_ring();
+        if(ring == NULL){return;}
+    }
+    uint64_t head = ring->head;
+    if(head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= EVENT_RING_SIZE){
+        ring->dropped++;
+        return;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    EventRecord* event = &ring->events[head & (EVENT_RING_SIZE - 1)];
+    event->ns = (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+    event->type = type;
+    event->thread = ring->thread;
+    event->arg = arg;
+    event->value0 = value0;
+    event->value1 = value1;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+uint64_t event_clock(){
+    // start time of a batch for event_rollouts, 0 while recording is off
+    if(!events_enabled){return 0;}
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+void event_rollouts(uint64_t start, int rollouts, double total_score){
+    // records a batch of rollouts started at start (from event_clock)
+    if(!events_enabled || start == 0){return;}
+    event_record(EVENT_ROLLOUTS, rollouts, rollouts ? total_score / rollouts : 0, event_clock() - start);
+}
+
+long long events_drain(const char* path){
+    /*appends the events recorded since the last drain to path (created with a header if new), oldest
+     first within each thread
+     safe to call while other threads are recording
+     returns the number of events written, -1 if path could not be opened
+    */
+    pthread_mutex_lock(&drain_lock);
+    FILE* file = fopen(path, "ab");
+    if(file == NULL){
+        pthread_mutex_unlock(&drain_lock);
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    if(ftell(file) == 0){
+        EventFileHeader header = {EVENT_MAGIC, EVENT_VERSION, sizeof(EventRecord)};
+        fwrite(&header, sizeof(header), 1, file);
+    }
+
+    long long written = 0;
+    for(EventRing* r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL; r = r->next){
+        uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = r->tail;
+        while(tail < head){
+            // up to the end of the ring, then from its start
+            uint64_t start = tail & (EVENT_RING_SIZE - 1);
+            uint64_t count = head - tail;
+            if(start + count > EVENT_RING_SIZE){count = EVENT_RING_SIZE - start;}
+            fwrite(&r->events[start], sizeof(EventRecord), count, file);
+            tail += count;
+            written += count;
+        }
+        __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+    }
+    fclose(file);
+    pthread_mutex_unlock(&drain_lock);
+    return written;
+}
+
+long long events_dropped(){
+    // events lost to full rings since the start of the process
+    long long dropped = 0;
+    for(EventRing* r = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); r != NULL; r = r->next){
+        dropped += __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+    }
+    return dropped;
+}
@@ -0,0 +1,607 @@
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "twency48.h"
+
+// Game farm
+// run_sweep over several machines. A coordinator splits a sweep (parameter sets, each playing games
+// seeded seed, seed+1, ... as run_sweep) into shards of consecutive games of one set, and hands them
+// out over TCP to workers, which play each shard on all their cores and send every game's result
+// as soon as it ends. The coordinator appends each result to the same CSV as run_sweep and, once
+// every game has a result, prints the paired statistics of sweep_stats.
+// A shard is re-queued when its worker disconnects or has not been heard from (a result or a
+// heartbeat) for the timeout, and handed to the next worker that asks. Results are kept by (set,
+// game), so a shard played twice (a slow worker that was given up on, then finishes) counts once.
+//   twency48/farm coordinator -g 1000 -o results.csv packed:1,10.28,0,4.48 packed:2,10.28,0,4.48
+//   twency48/farm worker -t 8 coordinator-host
+// Messages are fixed size FarmMessages in the byte order of the machines, which must agree.
+
+#define FARM_MAGIC 0x46383454 // "T48F"
+#define FARM_PORT "4848"
+#define FARM_MAX_PARAMS 8
+#define FARM_MAX_WORKERS 256
+
+typedef enum{
+    FARM_REQUEST = 1,       // worker: ready for a shard
+    FARM_SHARD = 2,         // coordinator: play games first .. first+count-1 of set
+    FARM_WAIT = 3,          // coordinator: every shard is out, ask again later
+    FARM_FINISHED = 4,      // coordinator: every game has a result
+    FARM_RESULT = 5,        // worker: the result of game first of shard
+    FARM_HEARTBEAT = 6,     // worker: still playing shard
+} FarmMessageType;
+
+typedef struct{
+    uint32_t magic;
+    int32_t type;           // FarmMessageType
+    int32_t shard;
+    int32_t set;
+    int32_t engine;
+    int32_t num_params;
+    double params[FARM_MAX_PARAMS];
+    uint64_t seed;          // game g of every set is seeded seed+g
+    int32_t first;          // FARM_SHARD: first game, FARM_RESULT: the game
+    int32_t count;          // FARM_SHARD: games in the shard
+    int32_t score;          // FARM_RESULT
+    int32_t max_tile;
+    int32_t turns;
+    int32_t heartbeat_ms;   // FARM_SHARD: interval between heartbeats, FARM_WAIT: time to wait
+} FarmMessage; // 120 bytes
+
+static volatile sig_atomic_t stopping = 0;
+
+static void stop(int signal){
+    (void)signal;
+    stopping = 1;
+}
+
+static double now_us(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec * 1e-3;
+}
+
+static bool send_message(int fd, FarmMessage* message){
+    message->magic = FARM_MAGIC;
+    size_t sent = 0;
+    while(sent < sizeof(*message)){
+        ssize_t n = send(fd, (char*)message + sent, sizeof(*message) - sent, MSG_NOSIGNAL);
+        if(n <= 0){
+            if(n < 0 && errno == EINTR){continue;}
+            return 0;
+        }
+        sent += n;
+    }
+    return 1;
+}
+
+static bool parse_config(const char* config, int* engine, double* params, int* num_params){
+    // engine:p0,p1,..., config is left as it is to name the set
+    char copy[1024];
+    snprintf(copy, sizeof(copy), "%s", config);
+    char* colon = strchr(copy, ':');
+    *engine = -1;
+    *num_params = 0;
+    if(colon == NULL){return 0;}
+    *colon = 0;
+    *engine = engine_by_name(copy);
+    for(char* p = strtok(colon + 1, ","); p != NULL && *num_params < FARM_MAX_PARAMS; p = strtok(NULL, ",")){
+        params[(*num_params)++] = atof(p);
+    }
+    return *engine >= 0 && *num_params > 0;
+}
+
+/* coordinator */
+
+typedef enum{
+    SHARD_PENDING,
+    SHARD_PLAYING,
+    SHARD_DONE,
+} ShardState;
+
+typedef struct{
+    int set;
+    int first;
+    int count;
+    int recorded;           // games of the shard with a result
+    ShardState state;
+    int owner;              // id of the connection playing it
+    double deadline_us;     // re-queued if the owner has not been heard from by then
+} Shard;
+
+typedef struct{
+    int fd;
+    int id;
+    int shard;              // the shard it was last given, -1 for none
+    uint8_t buffer[sizeof(FarmMessage)];
+    size_t buffered;
+} Connection;
+
+typedef struct{
+    int num_sets;
+    char** names;           // engine:params of each set, as given
+    int* engines;
+    double (*params)[FARM_MAX_PARAMS];
+    int* num_params;
+    uint64_t seed;
+    int num_games;
+    Shard* shards;
+    int num_shards;
+    int shards_done;
+    GameResult* results;    // num_sets * num_games, set major
+    bool* recorded;
+    double timeout_us;
+    FILE* out;
+} Coordinator;
+
+static void reply(Coordinator* c, Connection* conn){
+    // the next pending shard, in game major order as run_sweep, or why there is none
+    FarmMessage message = {0};
+    int s = 0;
+    while(s < c->num_shards && c->shards[s].state != SHARD_PENDING){s++;}
+    if(c->shards_done == c->num_shards){
+        message.type = FARM_FINISHED;
+    }else if(s == c->num_shards){
+        message.type = FARM_WAIT;
+        message.heartbeat_ms = 1000;
+    }else{
+        Shard* shard = &c->shards[s];
+        shard->state = SHARD_PLAYING;
+        shard->owner = conn->id;
+        shard->deadline_us = now_us() + c->timeout_us;
+        conn->shard = s;
+        message.type = FARM_SHARD;
+        message.shard = s;
+        message.set = shard->set;
+        message.engine = c->engines[shard->set];
+        message.num_params = c->num_params[shard->set];
+        memcpy(message.params, c->params[shard->set], sizeof(message.params));
+        message.seed = c->seed;
+        message.first = shard->first;
+        message.count = shard->count;
+        // a few heartbeats per timeout, so one late packet does not lose the shard
+        message.heartbeat_ms = c->timeout_us / 4000;
+    }
+    send_message(conn->fd, &message);
+}
+
+static void record(Coordinator* c, Connection* conn, FarmMessage* message){
+    if(message->shard < 0 || message->shard >= c->num_shards){return;}
+    Shard* shard = &c->shards[message->shard];
+    if(shard->state == SHARD_PLAYING && shard->owner == conn->id){
+        shard->deadline_us = now_us() + c->timeout_us;
+    }
+    if(message->type != FARM_RESULT){return;}
+    int g = message->first;
+    if(g < shard->first || g >= shard->first + shard->count){return;}
+    int i = shard->set * c->num_games + g;
+    if(c->recorded[i]){return;}
+    c->recorded[i] = 1;
+    c->results[i] = (GameResult){message->score, message->max_tile, message->turns};
+    if(c->out != NULL){
+        fprintf(c->out, "%d,%d,%llu,%d,%d,%d\n", shard->set, g, (unsigned long long)(c->seed + g), message->score, message->max_tile, message->turns);
+        fflush(c->out);
+    }
+    if(++shard->recorded == shard->count){
+        shard->state = SHARD_DONE;
+        c->shards_done++;
+    }
+}
+
+static void requeue(Coordinator* c, int s, const char* why){
+    Shard* shard = &c->shards[s];
+    if(shard->state != SHARD_PLAYING){return;}
+    shard->state = SHARD_PENDING;
+    fprintf(stderr, "shard %d (set %d, games %d-%d) re-queued: %s\n", s, shard->set, shard->first, shard->first + shard->count - 1, why);
+}
+
+static bool read_messages(Coordinator* c, Connection* conn){
+    // handles what the worker has sent, returns 0 once it has gone or sent something that is not a FarmMessage
+    ssize_t n = recv(conn->fd, conn->buffer + conn->buffered, sizeof(FarmMessage) - conn->buffered, 0);
+    if(n < 0 && (errno == EINTR || errno == EAGAIN)){return 1;}
+    if(n <= 0){return 0;}
+    conn->buffered += n;
+    if(conn->buffered == sizeof(FarmMessage)){
+        FarmMessage message;
+        memcpy(&message, conn->buffer, sizeof(message));
+        conn->buffered = 0;
+        if(message.magic != FARM_MAGIC){return 0;}
+        if(message.type == FARM_REQUEST){
+            reply(c, conn);
+        }else{
+            record(c, conn, &message);
+        }
+    }
+    return 1;
+}
+
+static int listen_on(const char* port){
+    struct addrinfo hints = {0}, *addresses;
+    hints.ai_family = AF_INET6;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_PASSIVE;
+    if(getaddrinfo(NULL, port, &hints, &addresses) != 0){
+        hints.ai_family = AF_INET;
+        if(getaddrinfo(NULL, port, &hints, &addresses) != 0){return -1;}
+    }
+    int fd = socket(addresses->ai_family, SOCK_STREAM, 0);
+    int on = 1, off = 0;
+    if(fd >= 0){
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        // both IPv4 and IPv6 workers
+        if(addresses->ai_family == AF_INET6){setsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &off, sizeof(off));}
+        if(bind(fd, addresses->ai_addr, addresses->ai_addrlen) != 0 || listen(fd, 64) != 0){
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(addresses);
+    return fd;
+}
+
+static int coordinate(int argc, char** argv){
+    Coordinator c = {0};
+    const char* port = FARM_PORT;
+    const char* results_path = NULL;
+    int shard_games = 10;
+    double timeout_s = 60;
+    c.seed = 1;
+    c.num_games = 100;
+    int opt;
+    while((opt = getopt(argc, argv, "p:g:s:n:T:o:")) != -1){
+        switch(opt){
+            case 'p': port = optarg; break;
+            case 'g': c.num_games = atoi(optarg); break;
+            case 's': c.seed = strtoull(optarg, NULL, 10); break;
+            case 'n': shard_games = atoi(optarg); break;
+            case 'T': timeout_s = atof(optarg); break;
+            case 'o': results_path = optarg; break;
+            default: return 2;
+        }
+    }
+    c.num_sets = argc - optind;
+    if(c.num_sets < 1 || c.num_games < 1 || shard_games < 1 || timeout_s <= 0){return 2;}
+    c.timeout_us = timeout_s * 1e6;
+
+    c.names = argv + optind;
+    c.engines = malloc(c.num_sets * sizeof(int));
+    c.params = calloc(c.num_sets, sizeof(*c.params));
+    c.num_params = malloc(c.num_sets * sizeof(int));
+    for(int s = 0; s < c.num_sets; s++){
+        if(!parse_config(c.names[s], &c.engines[s], c.params[s], &c.num_params[s])){
+            fprintf(stderr, "bad engine configuration %s\n", c.names[s]);
+            return 2;
+        }
+    }
+
+    // game major, so every set has played the first games before any set plays the later ones
+    int chunks = (c.num_games + shard_games - 1) / shard_games;
+    c.num_shards = chunks * c.num_sets;
+    c.shards = calloc(c.num_shards, sizeof(Shard));
+    for(int s = 0; s < c.num_shards; s++){
+        Shard* shard = &c.shards[s];
+        shard->set = s % c.num_sets;
+        shard->first = (s / c.num_sets) * shard_games;
+        shard->count = (shard->first + shard_games < c.num_games) ? shard_games : c.num_games - shard->first;
+    }
+    c.results = calloc((size_t)c.num_sets * c.num_games, sizeof(GameResult));
+    c.recorded = calloc((size_t)c.num_sets * c.num_games, sizeof(bool));
+    if(results_path != NULL){
+        c.out = fopen(results_path, "a");
+        if(c.out == NULL){
+            fprintf(stderr, "could not open %s\n", results_path);
+            return 1;
+        }
+    }
+
+    int listen_fd = listen_on(port);
+    if(listen_fd < 0){
+        fprintf(stderr, "could not listen on port %s\n", port);
+        return 1;
+    }
+    struct sigaction action = {0};
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+    fprintf(stderr, "coordinating %d shards of %d sets on port %s\n", c.num_shards, c.num_sets, port);
+
+    struct pollfd fds[FARM_MAX_WORKERS + 1];
+    Connection conns[FARM_MAX_WORKERS + 1];
+    int num_fds = 1;
+    int next_id = 0;
+    fds[0] = (struct pollfd){listen_fd, POLLIN, 0};
+    while(!stopping && c.shards_done < c.num_shards){
+        int ready = poll(fds, num_fds, 500);
+        for(int i = num_fds - 1; i >= 1 && ready > 0; i--){
+            if(!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))){continue;}
+            if(!read_messages(&c, &conns[i])){
+                int s = conns[i].shard;
+                if(s >= 0 && c.shards[s].owner == conns[i].id){requeue(&c, s, "worker disconnected");}
+                close(conns[i].fd);
+                fds[i] = fds[num_fds - 1];
+                conns[i] = conns[num_fds - 1];
+                num_fds--;
+            }
+        }
+        if(ready > 0 && (fds[0].revents & POLLIN)){
+            int fd = accept(listen_fd, NULL, NULL);
+            if(fd >= 0 && num_fds <= FARM_MAX_WORKERS){
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                conns[num_fds] = (Connection){fd, next_id++, -1, {0}, 0};
+                fds[num_fds] = (struct pollfd){fd, POLLIN, 0};
+                num_fds++;
+            }else if(fd >= 0){
+                close(fd);
+            }
+        }
+        double now = now_us();
+        for(int s = 0; s < c.num_shards; s++){
+            if(c.shards[s].state == SHARD_PLAYING && now > c.shards[s].deadline_us){requeue(&c, s, "timed out");}
+        }
+    }
+
+    // workers still connected are asking for work or playing shards already done, they are told
+    // to stop and their last messages are drained until they hang up, so closing does not reset
+    // the connection before they have read FARM_FINISHED
+    for(int i = 1; i < num_fds; i++){
+        FarmMessage message = {0};
+        message.type = FARM_FINISHED;
+        send_message(conns[i].fd, &message);
+        shutdown(conns[i].fd, SHUT_WR);
+    }
+    double give_up = now_us() + 5e6;
+    while(num_fds > 1 && now_us() < give_up){
+        if(poll(fds + 1, num_fds - 1, 100) <= 0){continue;}
+        for(int i = num_fds - 1; i >= 1; i--){
+            char discard[sizeof(FarmMessage)];
+            if((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && recv(fds[i].fd, discard, sizeof(discard), 0) <= 0){
+                close(fds[i].fd);
+                fds[i] = fds[num_fds - 1];
+                num_fds--;
+            }
+        }
+    }
+    for(int i = 1; i < num_fds; i++){close(fds[i].fd);}
+    close(listen_fd);
+    if(c.out != NULL){fclose(c.out);}
+
+    int status = 0;
+    if(c.shards_done < c.num_shards){
+        int recorded = 0;
+        for(int i = 0; i < c.num_sets * c.num_games; i++){recorded += c.recorded[i];}
+        printf("stopped with %d of %d games played\n", recorded, c.num_sets * c.num_games);
+        // 3 as twency48/eval, rerunning starts over, the results file keeps what was played
+        status = 3;
+    }else{
+        SweepStats* stats = malloc(c.num_sets * sizeof(SweepStats));
+        sweep_stats(c.results, c.num_sets, c.num_games, stats);
+        for(int s = 0; s < c.num_sets; s++){
+            SweepStats* st = &stats[s];
+            printf("set %d %s: mean %.1f, 2048 %.3f, 4096 %.3f, 8192 %.3f", s, c.names[s], st->mean_score, st->p2048, st->p4096, st->p8192);
+            if(s > 0){
+                printf(", vs set 0: score %+.1f +- %.1f, 2048 %+.3f +- %.3f", st->score_diff, st->score_diff_ci, st->p2048_diff, st->p2048_diff_ci);
+            }
+            printf("\n");
+        }
+        free(stats);
+    }
+    free(c.engines);
+    free(c.params);
+    free(c.num_params);
+    free(c.shards);
+    free(c.results);
+    free(c.recorded);
+    return status;
+}
+
+/* worker */
+
+typedef struct{
+    FarmMessage shard;
+    int fd;
+    int next_game;          // shared counter, taken with __atomic_fetch_add
+    int running;            // threads still playing, atomic
+    int sent;               // results sent, guarded by lock
+    volatile int lost;      // the coordinator has gone or finished, abandons the games in flight
+    pthread_mutex_t lock;   // serializes sends
+} ShardJob;
+
+static void* shard_worker(void* arg){
+    ShardJob* job = arg;
+    search_abort = &job->lost;
+    while(!job->lost && !stopping){
+        int g = __atomic_fetch_add(&job->next_game, 1, __ATOMIC_RELAXED);
+        if(g >= job->shard.count){break;}
+        int game = job->shard.first + g;
+        GameResult result = play_game(job->shard.engine, job->shard.params, job->shard.seed + game, NULL);
+        if(job->lost || stopping){break;}
+
+        FarmMessage message = {0};
+        message.type = FARM_RESULT;
+        message.shard = job->shard.shard;
+        message.set = job->shard.set;
+        message.first = game;
+        message.score = result.score;
+        message.max_tile = result.max_tile;
+        message.turns = result.turns;
+        pthread_mutex_lock(&job->lock);
+        if(send_message(job->fd, &message)){
+            job->sent++;
+        }else{
+            job->lost = 1;
+        }
+        pthread_mutex_unlock(&job->lock);
+    }
+    search_abort = NULL;
+    __atomic_sub_fetch(&job->running, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static bool receive_message(int fd, FarmMessage* message){
+    size_t received = 0;
+    while(received < sizeof(*message)){
+        ssize_t n = recv(fd, (char*)message + received, sizeof(*message) - received, 0);
+        if(n <= 0){
+            if(n < 0 && errno == EINTR && !stopping){continue;}
+            return 0;
+        }
+        received += n;
+    }
+    return message->magic == FARM_MAGIC;
+}
+
+static int play_shard(int fd, FarmMessage* shard, int num_threads, int* games){
+    /*plays the shard on num_threads threads while this one sends heartbeats and listens to the coordinator
+     returns FARM_RESULT when the shard is played, FARM_FINISHED if the coordinator finished meanwhile,
+     0 if it has gone, the results sent are added to games
+    */
+    ShardJob job = {0};
+    job.shard = *shard;
+    job.fd = fd;
+    pthread_mutex_init(&job.lock, NULL);
+    if(!engine_is_threadsafe(shard->engine)){num_threads = 1;}
+    pthread_t threads[num_threads];
+    int started = 0;
+    for(int t = 0; t < num_threads; t++){
+        __atomic_add_fetch(&job.running, 1, __ATOMIC_RELAXED);
+        if(pthread_create(&threads[started], NULL, shard_worker, &job) == 0){
+            started++;
+        }else{
+            __atomic_sub_fetch(&job.running, 1, __ATOMIC_RELAXED);
+        }
+    }
+    if(!started){
+        job.running = 1;
+        shard_worker(&job);
+    }
+
+    FarmMessage heartbeat = {0};
+    heartbeat.type = FARM_HEARTBEAT;
+    heartbeat.shard = shard->shard;
+    int interval_ms = (shard->heartbeat_ms > 0) ? shard->heartbeat_ms : 1000;
+    int outcome = FARM_RESULT;
+    double last = now_us();
+    while(__atomic_load_n(&job.running, __ATOMIC_ACQUIRE) > 0){
+        // the coordinator only speaks during a shard to say it has finished
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if(poll(&pfd, job.lost ? 0 : 1, 100) > 0){
+            FarmMessage message;
+            outcome = (receive_message(fd, &message) && message.type == FARM_FINISHED) ? FARM_FINISHED : 0;
+            job.lost = 1;
+        }
+        if(!job.lost && now_us() - last >= interval_ms * 1e3){
+            pthread_mutex_lock(&job.lock);
+            if(!send_message(fd, &heartbeat)){job.lost = 1;}
+            pthread_mutex_unlock(&job.lock);
+            last = now_us();
+        }
+    }
+    for(int t = 0; t < started; t++){
+        pthread_join(threads[t], NULL);
+    }
+    pthread_mutex_destroy(&job.lock);
+    *games += job.sent;
+    return (job.lost && outcome == FARM_RESULT) ? 0 : outcome;
+}
+
+static int connect_to(const char* host, const char* port, int attempts){
+    // retries every second, so workers can be started before the coordinator
+    for(int a = 0; a < attempts && !stopping; a++){
+        if(a > 0){sleep(1);}
+        struct addrinfo hints = {0}, *addresses;
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        if(getaddrinfo(host, port, &hints, &addresses) != 0){continue;}
+        for(struct addrinfo* address = addresses; address != NULL; address = address->ai_next){
+            int fd = socket(address->ai_family, SOCK_STREAM, 0);
+            if(fd < 0){continue;}
+            if(connect(fd, address->ai_addr, address->ai_addrlen) == 0){
+                int on = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+                freeaddrinfo(addresses);
+                return fd;
+            }
+            close(fd);
+        }
+        freeaddrinfo(addresses);
+    }
+    return -1;
+}
+
+static int work(int argc, char** argv){
+    const char* port = FARM_PORT;
+    int num_threads = 0;
+    int attempts = 30;
+    int opt;
+    while((opt = getopt(argc, argv, "p:t:r:")) != -1){
+        switch(opt){
+            case 'p': port = optarg; break;
+            case 't': num_threads = atoi(optarg); break;
+            case 'r': attempts = atoi(optarg); break;
+            default: return 2;
+        }
+    }
+    if(argc - optind != 1){return 2;}
+    const char* host = argv[optind];
+    if(num_threads <= 0){num_threads = sysconf(_SC_NPROCESSORS_ONLN);}
+
+    struct sigaction action = {0};
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    int fd = connect_to(host, port, attempts);
+    if(fd < 0){
+        fprintf(stderr, "could not connect to %s:%s\n", host, port);
+        return 1;
+    }
+    int games = 0, shards = 0;
+    bool finished = 0;
+    while(!stopping){
+        FarmMessage message = {0};
+        message.type = FARM_REQUEST;
+        if(!send_message(fd, &message) || !receive_message(fd, &message)){break;}
+        if(message.type == FARM_FINISHED){
+            finished = 1;
+            break;
+        }else if(message.type == FARM_WAIT){
+            usleep(message.heartbeat_ms * 1000);
+        }else if(message.type == FARM_SHARD){
+            if(engine_function(message.engine) == NULL){break;}
+            int outcome = play_shard(fd, &message, num_threads, &games);
+            shards++;
+            if(outcome != FARM_RESULT){
+                finished = outcome == FARM_FINISHED;
+                break;
+            }
+        }
+    }
+    close(fd);
+    fprintf(stderr, "sent %d results from %d shards%s\n", games, shards, finished ? "" : ", lost the coordinator");
+    return finished ? 0 : 1;
+}
+
+int main(int argc, char** argv){
+    const char* usage =
+        "usage: %s coordinator [-p port] [-g games] [-s seed] [-n games_per_shard] [-T timeout_s] [-o results.csv] engine:p0,p1,... [engine:p0,p1,... ...]\n"
+        "       %s worker [-p port] [-t threads] [-r connect_attempts] host\n"
+        "  the coordinator plays games seeded seed, seed+1, ... with every parameter set, as run_sweep, on the\n"
+        "  workers that connect to it, re-queueing the shards of workers silent for timeout_s\n"
+        "  -o appends set,game,seed,score,max_tile,turns as each game's result arrives\n";
+    int status = 2;
+    if(argc >= 2 && strcmp(argv[1], "coordinator") == 0){
+        status = coordinate(argc - 1, argv + 1);
+    }else if(argc >= 2 && strcmp(argv[1], "worker") == 0){
+        status = work(argc - 1, argv + 1);
+    }
+    if(status == 2){fprintf(stderr, usage, argv[0], argv[0]);}
+    return status;
+}
@@ -0,0 +1,146 @@
+#include <pthread.h>
+#include <string.h>
+#include "packed.h"
+
+// Bulk feature extraction
+// extract_features computes heuristic features of an array of packed boards into columns, one int32
+// per board for each Feature asked for, for analysis over whole traces without a Python loop per
+// position. The boards can be strided, so the board field of a memory mapped trace (Trace.py) is read
+// in place.
+// The features are the terms of the engine itself, from the same move tables: estimate_score of a
+// board with score s is params[3]*s - params[1]*FEATURE_PATH_PENALTY - params[2]*(FEATURE_MOVES == 0).
+// Boards are shared between threads a chunk at a time, and each chunk is done a block at a time, one
+// feature after another over the block while it is in L1, so every feature loop is short and free of
+// the branches choosing features. The word parallel loops (empties, max tile) vectorize, the others
+// are table lookups; the optimized builds clone extract_block per instruction set (HOT_CLONES).
+
+#define FEATURE_BLOCK 2048          // boards per block, 16KB
+#define FEATURE_CHUNK (64 * FEATURE_BLOCK)
+
+typedef struct{
+    const unsigned char* boards;
+    size_t stride;
+    uint64_t count;
+    int32_t** columns;
+    uint64_t next;          // first board of the next chunk, taken with __atomic_fetch_add
+} FeatureJob;
+
+static inline int nonzero_nibbles(uint64_t x){
+    // tiles in a packed board or row
+    x |= x >> 1;
+    x |= x >> 2;
+    return __builtin_popcountll(x & 0x1111111111111111ULL);
+}
+
+static inline int max_power(uint64_t b){
+    int max = 0;
+    for(int i = 0; i < 16; i++){
+        int p = (b >> (4*i)) & 0xF;
+        max = (p > max) ? p : max;
+    }
+    return max;
+}
+
+static inline int rows_monotonicity(uint64_t b, const MoveTables* t){
+    // path penalty of each row in its better direction
+    int pen = 0;
+    for(int r = 0; r < 4; r++){
+        uint16_t row = b >> (16*r);
+        pen += (t->path_fwd[row] < t->path_rev[row]) ? t->path_fwd[row] : t->path_rev[row];
+    }
+    return pen;
+}
+
+static inline int rows_merges(uint64_t b, const MoveTables* t){
+    // merges of moving every row left, the tiles that disappear
+    int merges = 0;
+    for(int r = 0; r < 4; r++){
+        uint16_t row = b >> (16*r);
+        merges += nonzero_nibbles(row) - nonzero_nibbles(t->left[row]);
+    }
+    return merges;
+}
+
+static inline int moves_mask(uint64_t b){
+    // bit m set if Move m is valid
+    int mask = 0;
+    for(int m = 0; m < 4; m++){
+        int gained = 0;
+        mask |= (apply_move_packed(b, m, &gained) != b) << m;
+    }
+    return mask;
+}
+
+HOT_CLONES static void extract_block(const uint64_t* b, int n, int32_t** columns, uint64_t first){
+    const MoveTables* t = move_tables;
+    int32_t* out;
+    if((out = columns[FEATURE_EMPTY]) != NULL){
+        for(int i = 0; i < n; i++){out[first + i] = 16 - nonzero_nibbles(b[i]);}
+    }
+    if((out = columns[FEATURE_MAX_TILE]) != NULL){
+        for(int i = 0; i < n; i++){out[first + i] = max_power(b[i]);}
+    }
+    if((out = columns[FEATURE_PATH_PENALTY]) != NULL){
+        for(int i = 0; i < n; i++){out[first + i] = path_penalty_packed(b[i]);}
+    }
+    if((out = columns[FEATURE_MONOTONICITY]) != NULL){
+        for(int i = 0; i < n; i++){out[first + i] = rows_monotonicity(b[i], t) + rows_monotonicity(transpose_packed(b[i]), t);}
+    }
+    if((out = columns[FEATURE_MERGES]) != NULL){
+        for(int i = 0; i < n; i++){out[first + i] = rows_merges(b[i], t) + rows_merges(transpose_packed(b[i]), t);}
+    }
+    if((out = columns[FEATURE_MOVES]) != NULL){
+        for(int i = 0; i < n; i++){out[first + i] = moves_mask(b[i]);}
+    }
+}
+
+static void* feature_worker(void* arg){
+    FeatureJob* job = arg;
+    uint64_t block[FEATURE_BLOCK];
+    while(true){
+        uint64_t first = __atomic_fetch_add(&job->next, FEATURE_CHUNK, __ATOMIC_RELAXED);
+        if(first >= job->count){break;}
+        uint64_t end = (first + FEATURE_CHUNK < job->count) ? first + FEATURE_CHUNK : job->count;
+        for(uint64_t i = first; i < end; i += FEATURE_BLOCK){
+            int n = (end - i < FEATURE_BLOCK) ? end - i : FEATURE_BLOCK;
+            const uint64_t* boards = (const uint64_t*)(job->boards + i * job->stride);
+            if(job->stride != sizeof(uint64_t)){
+                // gather strided boards (eg. trace records) into a contiguous block
+                for(int j = 0; j < n; j++){
+                    memcpy(&block[j], job->boards + (i + j) * job->stride, sizeof(uint64_t));
+                }
+                boards = block;
+            }
+            extract_block(boards, n, job->columns, i);
+        }
+    }
+    return NULL;
+}
+
+int extract_features(const void* boards, uint64_t count, size_t stride, int32_t** columns, int num_threads){
+    /*computes features of count packed boards
+        boards: the first board, the next is stride bytes on (0 for 8, packed boards next to each other)
+        columns: NUM_FEATURES pointers indexed by Feature, each to count int32s, NULL for the features not wanted
+        num_threads: worker threads, 0 for one per core
+     returns 0, -1 if stride is less than 8
+    */
+    if(stride == 0){stride = sizeof(uint64_t);}
+    if(stride < sizeof(uint64_t)){return -1;}
+    move_tables_init();
+
+    FeatureJob job = {boards, stride, count, columns, 0};
+    if(num_threads <= 0){num_threads = sysconf(_SC_NPROCESSORS_ONLN);}
+    // no more threads than chunks
+    uint64_t chunks = (count + FEATURE_CHUNK - 1) / FEATURE_CHUNK;
+    if((uint64_t)num_threads > chunks){num_threads = chunks ? chunks : 1;}
+    pthread_t threads[num_threads];
+    int started = 0;
+    for(int t = 1; t < num_threads; t++){
+        if(pthread_create(&threads[started], NULL, feature_worker, &job) == 0){started++;}
+    }
+    feature_worker(&job);
+    for(int t = 0; t < started; t++){
+        pthread_join(threads[t], NULL);
+    }
+    return 0;
+}
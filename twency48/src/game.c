@@ -0,0 +1,211 @@
+#include <time.h>
+#include <string.h>
+#include "twency48.h"
+
+// Native game loop
+// Plays whole games with any of the get_next_move style entry points, with spawns drawn from a
+// seeded Rng so a game can be replayed exactly and different engines can be given the same spawns.
+
+static const MoveFn engines[NUM_ENGINES] = {
+    [ENGINE_EXPECTIMAX] = get_next_move,
+    [ENGINE_EXPECTIMAX1] = get_next_move1,
+    [ENGINE_EXPECTIMAX_TT] = get_next_move_tt,
+    [ENGINE_EXPECTIMAX1_TT] = get_next_move1_tt,
+    [ENGINE_MCTS] = get_MCTS_next_move,
+    [ENGINE_MCTS1] = get_MCTS_next_move1,
+    [ENGINE_MCTS2] = get_MCTS_next_move2,
+    [ENGINE_MCTS3] = get_MCTS_next_move3,
+    [ENGINE_PACKED] = get_next_move_packed,
+    [ENGINE_PACKED_PRUNED] = get_next_move_packed_pruned,
+    [ENGINE_PACKED_ROLLOUT] = get_next_move_packed_rollout,
+    [ENGINE_PACKED_SAMPLED] = get_next_move_packed_sampled,
+    [ENGINE_UCT] = get_next_move_uct,
+    [ENGINE_MCTS_HALVING] = get_MCTS_next_move_halving,
+};
+
+// names used by the tools and Reporter.py
+static const char* engine_names[NUM_ENGINES] = {
+    [ENGINE_EXPECTIMAX] = "expectimax",
+    [ENGINE_EXPECTIMAX1] = "expectimax1",
+    [ENGINE_EXPECTIMAX_TT] = "expectimax_tt",
+    [ENGINE_EXPECTIMAX1_TT] = "expectimax1_tt",
+    [ENGINE_MCTS] = "mcts",
+    [ENGINE_MCTS1] = "mcts1",
+    [ENGINE_MCTS2] = "mcts2",
+    [ENGINE_MCTS3] = "mcts3",
+    [ENGINE_PACKED] = "packed",
+    [ENGINE_PACKED_PRUNED] = "packed_pruned",
+    [ENGINE_PACKED_ROLLOUT] = "packed_rollout",
+    [ENGINE_PACKED_SAMPLED] = "packed_sampled",
+    [ENGINE_UCT] = "uct",
+    [ENGINE_MCTS_HALVING] = "mcts_halving",
+};
+
+const char* engine_name(int engine){
+    if(engine < 0 || engine >= NUM_ENGINES){return NULL;}
+    return engine_names[engine];
+}
+
+int engine_by_name(const char* name){
+    // returns the engine called name, -1 if there is none
+    for(int e = 0; e < NUM_ENGINES; e++){
+        if(strcmp(engine_names[e], name) == 0){return e;}
+    }
+    return -1;
+}
+
+bool engine_is_threadsafe(int engine){
+    // the tt engines share one transposition table whose key salt (the params) is set per search,
+    // so only one game can use them at a time
+    return engine != ENGINE_EXPECTIMAX_TT && engine != ENGINE_EXPECTIMAX1_TT;
+}
+
+MoveFn engine_function(int engine){
+    // returns the entry point for engine, NULL if there is none
+    if(engine < 0 || engine >= NUM_ENGINES){return NULL;}
+    return engines[engine];
+}
+
+static int search_move(int engine, Board* board, double* params){
+    // engine_move without the book
+    int tiles[16];
+    powerep_to_intrep(board->tiles, tiles);
+    if(perf_level == PERF_OFF){return engines[engine](tiles, board->score, params);}
+    // the entry points reset search_stats, so the counts are stored after the call
+    PerfStats perf;
+    perf_begin();
+    int move = engines[engine](tiles, board->score, params);
+    perf_end(&perf);
+    search_stats.perf = perf;
+    return move;
+}
+
+int engine_move(int engine, Board* board, double* params){
+    // asks engine for the move to play on board, the opening book answers if it has the position (see book.c)
+    int move = book_engine_move(engine, board, params);
+    if(move >= 0){return move;}
+    return search_move(engine, board, params);
+}
+
+int place_random_tile_rng(Board* board, Rng* rng, int* value){
+    // place_random_tile with spawns drawn from rng
+    // returns the cell the tile was placed in and sets value to its power rep, -1 if the board is full
+    int empty_tiles[16];
+    int len_empty_tiles = get_empty_tiles(board, empty_tiles);
+    if(!len_empty_tiles){return -1;}
+    int tile = empty_tiles[rng_next(rng) % len_empty_tiles];
+    *value = (rng_double(rng) < 0.9) ? 1 : 2;
+    board->tiles[tile] = *value;
+    return tile;
+}
+
+Rng game_rollout_rng(uint64_t seed){
+    // the Rng the Monte Carlo engines draw from during the game seeded seed, a different stream from its spawns
+    return (Rng){seed ^ 0xa0761d6478bd642fULL};
+}
+
+int max_tile(Board* board){
+    // returns the largest tile on the board in int rep
+    int max = 0;
+    for(int i = 0; i < 16; i++){
+        max = (board->tiles[i] > max) ? board->tiles[i] : max;
+    }
+    return max ? (1 << max) : 0;
+}
+
+static double elapsed_us(struct timespec* start){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) * 1e-3;
+}
+
+void game_start(GameState* game, uint64_t seed){
+    /*sets game to the start of the game seeded seed: an empty board with two spawned tiles
+     spawns are drawn from a Rng seeded with seed, so the same seed always gives the same spawns for
+     the same moves
+     the engine's random numbers (rollout_rand) come from game_rollout_rng(seed), so single threaded engines
+     play the same game for the same seed, Monte Carlo ones included
+    */
+    int valid_moves[4];
+    *game = (GameState){{{0}, 0}, {seed}, game_rollout_rng(seed), 0, 0, 0};
+    int value;
+    place_random_tile_rng(&game->board, &game->spawns, &value);
+    place_random_tile_rng(&game->board, &game->spawns, &value);
+    game->over = !get_valid_moves(&game->board, valid_moves);
+}
+
+bool play_game_from(GameState* game, int engine, double* params, GameHook hook, void* context){
+    /*plays game on until there are no valid moves, hook returns 0 or the thread's search_abort is set
+     hook, if not NULL, is called after every move with context
+     a move whose search was cut short by search_abort is not played, game is left at the turn before it
+     game holds everything needed to carry on, so a saved copy continues the game as if it had not stopped
+     returns game->over
+    */
+    Rng* saved_rollout_rng = rollout_rng;
+    rollout_rng = &game->rollouts;
+    int valid_moves[4];
+    while(get_valid_moves(&game->board, valid_moves)){
+        if(search_abort && *search_abort){break;}
+        // not every engine resets search_stats
+        search_stats = (SearchStats){0};
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        Board before;
+        copy_board_values(&game->board, &before);
+        int move = game->skip_book ? search_move(engine, &game->board, params) : engine_move(engine, &game->board, params);
+        double search_us = elapsed_us(&start);
+        if(search_abort && *search_abort){break;}
+
+        if(!apply_move(&game->board, move)){
+            // engines only return valid moves, but never loop forever if one does not
+            move = valid_moves[0];
+            apply_move(&game->board, move);
+        }
+        int value;
+        int cell = place_random_tile_rng(&game->board, &game->spawns, &value);
+        game->turns++;
+        if(hook != NULL && !hook(context, game, &before, move, cell, value, search_us)){break;}
+    }
+    rollout_rng = saved_rollout_rng;
+    game->over = !get_valid_moves(&game->board, valid_moves);
+    return game->over;
+}
+
+static bool trace_hook(void* context, const GameState* game, const Board* before, int move, int cell, int value, double search_us){
+    SearchStats stats;
+    get_search_stats(&stats);
+    trace_record(context, (Board*)before, move, game->board.score - before->score, cell, value, &stats, search_us);
+    return 1;
+}
+
+GameResult play_game(int engine, double* params, uint64_t seed, TraceWriter* trace){
+    /*plays the game seeded seed (see game_start) until there are no valid moves
+     every turn is written to trace if it is not NULL
+    */
+    GameState game;
+    game_start(&game, seed);
+    if(trace != NULL){trace_begin_game(trace, seed);}
+    play_game_from(&game, engine, params, (trace != NULL) ? trace_hook : NULL, trace);
+    if(trace != NULL){trace_end_game(trace, &game.board);}
+    return (GameResult){game.board.score, max_tile(&game.board), game.turns};
+}
+
+int play_games(int engine, double* params, uint64_t seed, int num_games, const char* trace_path, GameResult* results){
+    /*plays num_games games with seeds seed, seed+1, ...
+     if trace_path is not NULL every turn is appended to the trace at trace_path
+     results (length num_games) may be NULL
+     returns the number of games played, -1 if the trace could not be opened or engine is not valid
+    */
+    if(engine_function(engine) == NULL){return -1;}
+    TraceWriter* trace = NULL;
+    if(trace_path != NULL){
+        trace = trace_open(trace_path);
+        if(trace == NULL){return -1;}
+    }
+    for(int g = 0; g < num_games; g++){
+        GameResult result = play_game(engine, params, seed + g, trace);
+        if(results != NULL){results[g] = result;}
+    }
+    trace_close(trace);
+    return num_games;
+}
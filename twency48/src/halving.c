@@ -0,0 +1,95 @@
+#include "twency48.h"
+
+// Successive halving
+// get_MCTS_next_move_halving is get_MCTS_next_move2 with a total rollout budget instead of a fixed
+// count per move. The budget is split into ceil(log2(moves)) rounds; each round plays an equal share
+// of its part of the budget after every move still in, and then drops the worse half of them by mean
+// score so far. A move that is clearly losing is dropped after the first round instead of taking a
+// quarter of the budget, and the rollouts go to telling the good moves apart.
+// Rollouts are played with run_rollouts, so they use the rollout pool when it is on. Scores are summed
+// in 64 bits, and the rollouts each move got are left in search_stats.arm_rollouts.
+
+typedef struct{
+    int move;
+    long long sum;
+    long long rollouts;
+} Arm;
+
+static double arm_mean(const Arm* arm){
+    return arm->rollouts ? (double)arm->sum / arm->rollouts : 0;
+}
+
+static void sort_arms(Arm* arms, int n){
+    // best mean first, insertion sort of at most 4
+    for(int i = 1; i < n; i++){
+        Arm a = arms[i];
+        int j = i - 1;
+        while(j >= 0 && arm_mean(&arms[j]) < arm_mean(&a)){
+            arms[j + 1] = arms[j];
+            j--;
+        }
+        arms[j + 1] = a;
+    }
+}
+
+int get_MCTS_next_move_halving(int* tiles, int score, double* params){
+    /*takes in the set of tiles (in int rep form), the current score, and a set of parameters
+        [0]: rollouts to play in total
+        [1]: path_penalty, [2]: loss_penalty, [3]: score_factor, used by the greedy and em rollout policies
+        [4]: rollout policy (RolloutPolicy), 0 for random moves as get_MCTS_next_move2
+     returns the best move from this state, UP if there is no valid move
+    */
+    search_stats = (SearchStats){0};
+    long long budget = params[0];
+    int policy = params[4];
+
+    char powertiles[16];
+    intrep_to_powerrep(powertiles, tiles);
+    Board b;
+    for(int i = 0; i < 16; i++){
+        b.tiles[i] = powertiles[i];
+    }
+    b.score = score;
+
+    int valid_moves[4];
+    int k = get_valid_moves(&b, valid_moves);
+    if(k == 0){return UP;}
+    if(k == 1){return valid_moves[0];}
+
+    Arm arms[4];
+    for(int i = 0; i < k; i++){arms[i] = (Arm){valid_moves[i], 0, 0};}
+    int rounds = (k > 2) ? 2 : 1;   // ceil(log2(k)) for k <= 4
+    int alive = k;
+    long long spent = 0, total = 0;
+    uint64_t start = event_clock();
+    for(int r = 0; r < rounds; r++){
+        // the last round takes whatever the earlier ones left
+        long long share = (r + 1 < rounds) ? budget / rounds : budget - spent;
+        int per_arm = share / alive;
+        per_arm = (per_arm < 1) ? 1 : per_arm;
+
+        int moves[4], trials[4];
+        long long sums[4];
+        for(int i = 0; i < alive; i++){
+            moves[i] = arms[i].move;
+            trials[i] = per_arm;
+        }
+        run_rollouts(&b, moves, trials, alive, policy, params, sums);
+        for(int i = 0; i < alive; i++){
+            arms[i].sum += sums[i];
+            total += sums[i];
+            arms[i].rollouts += per_arm;
+            spent += per_arm;
+        }
+        sort_arms(arms, alive);
+        alive = (alive + 1) / 2;
+    }
+    event_rollouts(start, spent, total);
+
+    for(int i = 0; i < k; i++){
+        search_stats.arm_rollouts[arms[i].move] = arms[i].rollouts;
+        search_stats.move_values[arms[i].move] = arm_mean(&arms[i]);
+        event_emit(EVENT_ARM, arms[i].move, arm_mean(&arms[i]), arms[i].rollouts);
+    }
+    return arms[0].move;
+}
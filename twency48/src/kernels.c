@@ -0,0 +1,228 @@
+#include <string.h>
+#include "packed.h"
+
+// Specialised search kernels
+// search_kernel.h is included once per configuration below, each include producing emm_<suffix> and
+// get_next_move_<suffix>. A configuration picks a board representation (the char_ or packed_
+// operations in this file), a leaf evaluator, a pruning policy and a chance node policy. To add an
+// engine, add an include.
+// A packed search that reaches a move merging two 32768s stops (packed_exact) and is redone with the
+// unpacked search, as searches from boards with tiles past 32768 are.
+
+typedef struct{
+    // params read once per search instead of at every leaf
+    double path_penalty;
+    double loss_penalty;
+    double score_factor;
+    double prob_cutoff;
+    int sample_above;       // chance nodes with more empty tiles than this are sampled
+    int sample_cells;       // empty tiles searched at a sampled chance node
+    uint64_t sample_seed;
+    double* raw;            // for evaluators that take the params array
+} KernelParams;
+
+#define KERNEL_EVAL_HEURISTIC 0
+#define KERNEL_EVAL_ROLLOUT 1
+
+static const int kernel_moves[4] = {UP, DOWN, LEFT, RIGHT}; // same order as get_valid_moves
+
+static inline void kernel_params(double* params, KernelParams* kp, bool prune, bool sample){
+    // params past [3] are only read by kernels that use them, the others take the 4 params of get_next_move
+    kp->path_penalty = params[1];
+    kp->loss_penalty = params[2];
+    kp->score_factor = params[3];
+    kp->prob_cutoff = prune ? params[4] : 0;
+    kp->sample_above = sample ? params[4] : 16;
+    kp->sample_cells = sample ? params[5] : 16;
+    kp->sample_cells = (kp->sample_cells < 2) ? 2 : kp->sample_cells; // the variance estimate needs two
+    kp->sample_seed = sample ? (uint64_t)params[6] : 0;
+    kp->raw = params;
+}
+
+
+// char_: the Board struct used by the rest of the engine
+
+typedef Board char_t;
+
+static inline bool char_from_board(Board* board, char_t* b){
+    *b = *board;
+    return 1;
+}
+
+static inline void char_to_board(char_t b, int score, Board* board){
+    *board = b;
+    board->score = score;
+}
+
+static inline bool char_move(char_t b, int move, char_t* out, int* gained){
+    *out = b;
+    out->score = 0;
+    int valid = apply_move(out, move);
+    *gained += out->score;
+    return valid;
+}
+
+static inline bool char_begin_exact(){
+    return 1;
+}
+
+static inline bool char_exact(){
+    return 1;
+}
+
+static inline bool char_end_exact(bool outer){
+    return 1;
+}
+
+static inline bool char_has_moves(char_t b){
+    int valid_moves[4];
+    return get_valid_moves(&b, valid_moves) > 0;
+}
+
+static inline int char_empties(char_t b, int* cells){
+    return get_empty_tiles(&b, cells);
+}
+
+static inline char_t char_spawn(char_t b, int cell, int value){
+    b.tiles[cell] = value;
+    return b;
+}
+
+static inline uint64_t char_key(char_t b){
+    uint64_t halves[2];
+    memcpy(halves, b.tiles, 16);
+    return halves[0] ^ (halves[1] * 0x9E3779B97F4A7C15ULL);
+}
+
+static inline double char_heuristic(char_t b, int score, const KernelParams* kp){
+    // estimate_score
+    static const int path[16] = {3,2,1,0,4,5,6,7,11,10,9,8,12,13,14,15};
+    int tiles[16];
+    powerep_to_intrep(b.tiles, tiles);
+    double penalty = char_has_moves(b) ? 0 : kp->loss_penalty;
+    double path_pen = 0;
+    for(int i = 0; i < 15; i++){
+        if(tiles[path[i]] > tiles[path[i+1]]){
+            path_pen += tiles[path[i]] - tiles[path[i+1]];
+        }
+    }
+    penalty += kp->path_penalty * path_pen;
+    return kp->score_factor * score - penalty;
+}
+
+
+// packed_: 64 bit boards moved with lookup tables, see packed.h
+
+typedef uint64_t packed_t;
+
+static inline bool packed_from_board(Board* board, packed_t* b){
+    move_tables_init();
+    return pack_board(board, b);
+}
+
+static inline void packed_to_board(packed_t b, int score, Board* board){
+    unpack_board(b, board);
+    board->score = score;
+}
+
+// set when a search reaches a move that merges two 32768s, the search is then redone on unpacked boards
+static __thread bool packed_unpackable = 0;
+
+static inline bool packed_begin_exact(){
+    // returns the state of an enclosing search, for packed_end_exact
+    bool outer = packed_unpackable;
+    packed_unpackable = 0;
+    return outer;
+}
+
+static inline bool packed_exact(){
+    return !packed_unpackable;
+}
+
+static inline bool packed_end_exact(bool outer){
+    // 1 if no move since packed_begin_exact was unpackable
+    bool exact = !packed_unpackable;
+    packed_unpackable = outer;
+    return exact;
+}
+
+static inline bool packed_move(packed_t b, int move, packed_t* out, int* gained){
+    if(move_unpackable_packed(b, move)){
+        packed_unpackable = 1;
+        return 0;
+    }
+    *out = apply_move_packed(b, move, gained);
+    return *out != b;
+}
+
+static inline bool packed_has_moves(packed_t b){
+    return has_valid_move_packed(b);
+}
+
+static inline int packed_empties(packed_t b, int* cells){
+    int length = 0;
+    for(int i = 0; i < 16; i++){
+        if(((b >> (4*i)) & 0xF) == 0){
+            cells[length++] = i;
+        }
+    }
+    return length;
+}
+
+static inline packed_t packed_spawn(packed_t b, int cell, int value){
+    return b | ((uint64_t)value << (4*cell));
+}
+
+static inline uint64_t packed_key(packed_t b){
+    return b;
+}
+
+static inline double packed_heuristic(packed_t b, int score, const KernelParams* kp){
+    double penalty = packed_has_moves(b) ? 0 : kp->loss_penalty;
+    penalty += kp->path_penalty * path_penalty_packed(b);
+    return kp->score_factor * score - penalty;
+}
+
+
+// instances
+
+// emm_char: expectiminmax with its params folded, the reference for the other kernels
+#define KERNEL_SUFFIX char
+#define KERNEL_REPR char_
+#define KERNEL_EVAL KERNEL_EVAL_HEURISTIC
+#define KERNEL_PRUNE 0
+#define KERNEL_SAMPLE 0
+#include "search_kernel.h"
+
+// emm_packed: expectiminmax on packed boards
+#define KERNEL_SUFFIX packed
+#define KERNEL_REPR packed_
+#define KERNEL_EVAL KERNEL_EVAL_HEURISTIC
+#define KERNEL_PRUNE 0
+#define KERNEL_SAMPLE 0
+#include "search_kernel.h"
+
+// emm_packed_pruned: packed, decision nodes less likely than params[4] are evaluated as leaves
+#define KERNEL_SUFFIX packed_pruned
+#define KERNEL_REPR packed_
+#define KERNEL_EVAL KERNEL_EVAL_HEURISTIC
+#define KERNEL_PRUNE 1
+#define KERNEL_SAMPLE 0
+#include "search_kernel.h"
+
+// emm_packed_rollout: packed, every leaf estimated with estimate_score1 rollouts (params[4] trials)
+#define KERNEL_SUFFIX packed_rollout
+#define KERNEL_REPR packed_
+#define KERNEL_EVAL KERNEL_EVAL_ROLLOUT
+#define KERNEL_PRUNE 0
+#define KERNEL_SAMPLE 0
+#include "search_kernel.h"
+
+// emm_packed_sampled: packed, chance nodes with more than params[4] empty tiles only search a stratified
+// sample of params[5] of them, drawn from a Rng seeded with params[6] and the board
+#define KERNEL_SUFFIX packed_sampled
+#define KERNEL_REPR packed_
+#define KERNEL_EVAL KERNEL_EVAL_HEURISTIC
+#define KERNEL_PRUNE 0
+#define KERNEL_SAMPLE 1
+#include "search_kernel.h"
@@ -1,36 +1,15 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-#include <float.h>
-#include <stdbool.h>
-#include <unistd.h>
-#include <math.h>
+#include "twency48.h"
 
 
-
-typedef struct{
-    // each row is represented by a char, starting in top right corner
-    // each char represents the power of the tile (2^tile_value), unless it is 0 in which case 00000000 = 0 != 2^0
-    // score represents the current score in the game
-
-    char tiles[16]; 
-    int score; 
-} Board;
-
-typedef enum{
-    UP = 2,
-    DOWN = 3,
-    LEFT = 1,
-    RIGHT = 0,
-    NONE = -1
-}Move;
-
 static Move moves[4] = {UP, DOWN, LEFT, RIGHT};
 
+__thread volatile int* search_abort = NULL;
+__thread SearchStats search_stats;
+
 double get_rand() {return (double)rand() / (double) RAND_MAX;}
 
 
-int apply_move(Board* board, Move move){
+HOT_CLONES int apply_move(Board* board, Move move){
     //modifies referenced board by applying specified move
     //returns 1 if move is valid
     int valid_move = 0;
@@ -311,6 +290,30 @@ void copy_board_values(Board* b1, Board* b2){
     }
 }
 
+bool pack_board(Board* board, uint64_t* packed){
+    //packs the power rep tiles into 4 bits each, tile 0 in the lowest bits
+    //returns 0 if a tile is too large to pack (65536 or above)
+    uint64_t p = 0;
+    for(int i = 0; i < 16; i++){
+        if(board->tiles[i] > 15){return 0;}
+        p |= (uint64_t)board->tiles[i] << (4*i);
+    }
+    *packed = p;
+    return 1;
+}
+
+void unpack_board(uint64_t packed, Board* board){
+    //inverse of pack_board, score is left unchanged
+    for(int i = 0; i < 16; i++){
+        board->tiles[i] = (packed >> (4*i)) & 0xF;
+    }
+}
+
+void get_search_stats(SearchStats* stats){
+    //copies the stats of the last search run on the calling thread
+    *stats = search_stats;
+}
+
 void powerep_to_intrep(char* powerrep, int* intrep){
     //converts from char based power rep to nice looking int rep
     for(int i = 0; i < 16; i++){
@@ -342,7 +345,7 @@ static void print_board(Board* board){
     printf("\n");
 }
 
-double estimate_score(Board* board, double* params){
+HOT_CLONES double estimate_score(Board* board, double* params){
     // use heuristic to estimate score
     /*
     [0]: depth
@@ -374,18 +377,88 @@ double estimate_score(Board* board, double* params){
     return params[3] * score - penalty;
 
 }
+// incremental estimate_score for the children of a chance node
+// a spawn changes one tile, so of the 15 path terms only the (up to) two next to that tile change
+
+static const int snake_path[16] = {3,2,1,0,4,5,6,7,11,10,9,8,12,13,14,15};
+static const int snake_index[16] = {3,2,1,0,4,5,6,7,11,10,9,8,12,13,14,15}; // position of each tile on snake_path
+
+typedef struct{
+    int tiles[16];  // int rep
+    int path_pen;   // path penalty before params[1] is applied
+} HeuristicParts;
+
+static inline int path_term(const int* tiles, int i){
+    // penalty between the i'th and i+1'th tiles of the path
+    int a = tiles[snake_path[i]];
+    int b = tiles[snake_path[i+1]];
+    return (a > b) ? a - b : 0;
+}
+
+static void heuristic_parts(Board* board, HeuristicParts* parts){
+    powerep_to_intrep(board->tiles, parts->tiles);
+    parts->path_pen = 0;
+    for(int i = 0; i < 15; i++){
+        parts->path_pen += path_term(parts->tiles, i);
+    }
+}
+
+static double estimate_score_spawn(HeuristicParts* parts, Board* board, int cell, char value, int empty_len, double* params){
+    /*estimate_score of board with value (power rep) spawned in the empty tile cell, parts is from board
+     only a spawn into the last empty tile can leave no valid moves, the board is only copied then
+    */
+    int p = snake_index[cell];
+    int path_pen = parts->path_pen;
+    if(p > 0){path_pen -= path_term(parts->tiles, p-1);}
+    if(p < 15){path_pen -= path_term(parts->tiles, p);}
+    parts->tiles[cell] = 1 << value;
+    if(p > 0){path_pen += path_term(parts->tiles, p-1);}
+    if(p < 15){path_pen += path_term(parts->tiles, p);}
+    parts->tiles[cell] = 0;
+
+    double penalty = 0;
+    if(empty_len == 1){
+        Board b1;
+        copy_board_values(board, &b1);
+        set_tile(&b1, cell, value);
+        int valid_moves[4];
+        if(!get_valid_moves(&b1, valid_moves)){
+            penalty += params[2];
+        }
+    }
+    penalty += params[1] * path_pen;
+    return params[3] * (double)board->score - penalty;
+}
+
+static double chance_node_leaves(Board* board, double* params){
+    // the chance node of expectiminmax at depth 1, same value without searching each child
+    int phase = perf_phase(PERF_PHASE_LEAVES);
+    HeuristicParts parts;
+    heuristic_parts(board, &parts);
+    int empty_tiles[16];
+    int empty_len = get_empty_tiles(board, empty_tiles);
+    search_stats.nodes += 2 * empty_len;
+    double result = 0;
+    for(int i = 0; i < empty_len; i++){
+        result += 0.9/empty_len * estimate_score_spawn(&parts, board, empty_tiles[i], 1, empty_len, params);
+        result += 0.1/empty_len * estimate_score_spawn(&parts, board, empty_tiles[i], 2, empty_len, params);
+    }
+    perf_phase(phase);
+    return result;
+}
+
 void place_random_tile(Board* board){
     // place a tile in a randomly selected empty square
     
     int empty_tiles[15];
     int len_empty_tiles = get_empty_tiles(board, empty_tiles);
-    int tile = empty_tiles[rand() % (len_empty_tiles)];
-    int tile_value = ((double)rand()/(double)RAND_MAX > 0.1) ? 1 : 2;
+    int tile = empty_tiles[rollout_rand() % (len_empty_tiles)];
+    int tile_value = ((double)rollout_rand()/(double)RAND_MAX > 0.1) ? 1 : 2;
 
     board->tiles[tile] = tile_value;
 }
 
-int run_random_trial(Board* board, Move move){
+HOT_CLONES int run_random_trial(Board* board, Move move){
     Move next_move = move;
     Board b2;
     copy_board_values(board, &b2);
@@ -398,9 +471,10 @@ int run_random_trial(Board* board, Move move){
         if(!num_valid_moves){
             return b2.score;
         }
-        next_move = valid_moves[rand() % (num_valid_moves)];      
+        next_move = valid_moves[rollout_rand() % (num_valid_moves)];      
         apply_move(&b2, next_move);
         place_random_tile(&b2);
+        rollout_steps++;
     }
 }
 double estimate_score1(Board* board, double* params){
@@ -418,9 +492,21 @@ double estimate_score1(Board* board, double* params){
     int k = get_valid_moves(board, valid_moves);
 
     
-    for(int t = 1; t < num_trials; t++){
-        score += run_random_trial(board,rand() % (k));
+    uint64_t batch_start = event_clock();
+    if(k && num_trials > 1){
+        // the rollouts are spread evenly over the valid moves
+        int trials[4];
+        long long sums[4];
+        for(int i = 0; i < k; i++){
+            trials[i] = (num_trials - 1) / k + (i < (num_trials - 1) % k);
+        }
+        run_rollouts(board, valid_moves, trials, k, ROLLOUT_RANDOM, params, sums);
+        for(int i = 0; i < k; i++){score += sums[i];}
+    }else if(num_trials > 1){
+        // no move left, every rollout ends where it starts
+        score = (double)board->score * (num_trials - 1);
     }
+    event_rollouts(batch_start, num_trials - 1, score);
     score = score/(double)num_trials;
 
 
@@ -447,11 +533,13 @@ double estimate_score1(Board* board, double* params){
 
 }
 
-double expectiminmax(Board* board, double* params, bool choose_move, int depth){
+HOT_CLONES double expectiminmax(Board* board, double* params, bool choose_move, int depth){
     // use expectiminmax to evaluate states
     // Choose move == 1 indicates the current state is the users turn to choose the move
     // else, random state
     double result;
+    if(search_abort && *search_abort){return 0;}
+    search_stats.nodes++;
     int loss = 1;
     int valid_moves[4];
     int num_valid_moves = get_valid_moves(board, valid_moves);
@@ -473,6 +561,8 @@ double expectiminmax(Board* board, double* params, bool choose_move, int depth){
             result = (result > emm_result) ? result : emm_result;
             
         }
+    }else if(depth == 1){
+        result = chance_node_leaves(board, params);
     }else{
         result = 0;
         int empty_tiles[16];
@@ -499,6 +589,8 @@ double expectiminmax1(Board* board, double* params, bool choose_move, int depth)
     // Choose move == 1 indicates the current state is the users turn to choose the move
     // else, random state
     double result;
+    if(search_abort && *search_abort){return 0;}
+    search_stats.nodes++;
     int loss = 1;
     int valid_moves[4];
     int num_valid_moves = get_valid_moves(board, valid_moves);
@@ -544,6 +636,135 @@ double expectiminmax1(Board* board, double* params, bool choose_move, int depth)
 
 
 
+double expectiminmax_tt(Board* board, double* params, bool choose_move, int depth){
+    // expectiminmax with decision and chance nodes cached in the transposition table
+    double result;
+    if(search_abort && *search_abort){return 0;}
+    search_stats.nodes++;
+    uint64_t key;
+    bool cacheable = depth > 0 && pack_board(board, &key);
+    if(cacheable && tt_probe(key, board->score, !choose_move, depth, &result)){
+        search_stats.tt_hits++;
+        return result;
+    }
+
+    int loss = 1;
+    int valid_moves[4];
+    int num_valid_moves = get_valid_moves(board, valid_moves);
+    if(num_valid_moves){
+        loss = 0;
+    }
+
+    if(depth == 0 || loss){
+        return estimate_score(board, params);
+    }
+
+    if(choose_move){
+        result = params[2];
+        for(int i = 0; i < num_valid_moves; i ++){
+            Board b1;
+            copy_board_values(board, &b1);
+            apply_move(&b1, valid_moves[i]);
+            double emm_result = expectiminmax_tt(&b1, params, false, depth-1);
+            result = (result > emm_result) ? result : emm_result;
+
+        }
+    }else if(depth == 1){
+        result = chance_node_leaves(board, params);
+    }else{
+        result = 0;
+        int empty_tiles[16];
+        int empty_len = get_empty_tiles(board, empty_tiles);
+        for(int i = 0; i < empty_len; i++){
+            Board b1;
+            Board b2;
+            copy_board_values(board, &b1);
+            copy_board_values(board, &b2);
+
+            set_tile(&b1, empty_tiles[i], 1); //set with exp value
+            set_tile(&b2, empty_tiles[i], 2);
+
+            result += 0.9/empty_len * expectiminmax_tt(&b1, params, true, depth-1);
+            result += 0.1/empty_len * expectiminmax_tt(&b2, params, true, depth-1);
+        }
+
+    }
+    if(cacheable && !(search_abort && *search_abort)){
+        tt_store(key, board->score, !choose_move, depth, result);
+        search_stats.tt_stores++;
+    }
+    return result;
+}
+
+double expectiminmax1_tt(Board* board, double* params, bool choose_move, int depth){
+    // expectiminmax1 with the levels below the root's children cached in the transposition table
+    if(search_abort && *search_abort){return 0;}
+    search_stats.nodes++;
+    double result;
+    int valid_moves[4];
+    int num_valid_moves = get_valid_moves(board, valid_moves);
+
+    if(depth == 0 || !num_valid_moves){
+        return estimate_score1(board, params);
+    }
+
+    if(choose_move){
+        result = params[2];
+        for(int i = 0; i < num_valid_moves; i ++){
+            Board b1;
+            copy_board_values(board, &b1);
+            apply_move(&b1, valid_moves[i]);
+            double emm_result = expectiminmax_tt(&b1, params, false, depth-1);
+            result = (result > emm_result) ? result : emm_result;
+        }
+    }else{
+        result = 0;
+        int empty_tiles[16];
+        int empty_len = get_empty_tiles(board, empty_tiles);
+        for(int i = 0; i < empty_len; i++){
+            Board b1;
+            Board b2;
+            copy_board_values(board, &b1);
+            copy_board_values(board, &b2);
+
+            set_tile(&b1, empty_tiles[i], 1); //set with exp value
+            set_tile(&b2, empty_tiles[i], 2);
+
+            result += 0.9/empty_len * expectiminmax_tt(&b1, params, true, depth-1);
+            result += 0.1/empty_len * expectiminmax_tt(&b2, params, true, depth-1);
+        }
+    }
+    return result;
+}
+
+
+
+int search_root(Board* board, double* params, SearchFn search, double* move_scores){
+    // searches each valid move from board to depth params[0] with search
+    // move_scores (indexed by Move) is set to the score of each move, -INFINITY for invalid moves
+    // returns the best move, UP if there is no valid move
+    int valid_moves[4];
+    int num_valid_moves = get_valid_moves(board, valid_moves);
+    for(int i = 0; i < 4; i++){
+        move_scores[i] = -INFINITY;
+    }
+    if(!num_valid_moves){return UP;}
+
+    double max_score = -1000000000;
+    Move max_move = valid_moves[0];
+    for(int i = 0; i < num_valid_moves; i++){
+        Board b_cp;
+        copy_board_values(board, &b_cp);
+        apply_move(&b_cp, valid_moves[i]);
+        move_scores[valid_moves[i]] = search(&b_cp, params, false, params[0]-1);
+        if(max_score < move_scores[valid_moves[i]]){
+            max_score = move_scores[valid_moves[i]];
+            max_move = valid_moves[i];
+        }
+    }
+    return max_move;
+}
+
 int get_next_move(int* tiles, int score, double* params){
     /*takes in the set of tiles (in int rep form), the current score, and a set of parameters
         [0]: depth
@@ -552,6 +773,8 @@ int get_next_move(int* tiles, int score, double* params){
         [3]: score_factor
      returns the best move from this state
     */
+    search_stats = (SearchStats){0};
+    search_stats.depth = params[0];
     int start_val = -1000000000;
     char powertiles[16];
     intrep_to_powerrep(powertiles, tiles);
@@ -572,7 +795,7 @@ int get_next_move(int* tiles, int score, double* params){
         max_move = valid_moves[0];
     }
     else{return moves[0];}
-    
+    event_emit(EVENT_SEARCH_BEGIN, params[0], 0, 0);
 
     for(int i=0; i<num_valid_moves; i++){
         //printf("is_valid: %d\n", check_valid_move(&b, moves[i]));
@@ -585,13 +808,15 @@ int get_next_move(int* tiles, int score, double* params){
             max_score = scores[i];
             max_move = valid_moves[i];
         }
+        search_stats.move_values[valid_moves[i]] = scores[i];
+        event_emit(EVENT_ROOT_MOVE, valid_moves[i], scores[i], 0);
 
         //printf("%d: %f\n, ", moves[i], scores[i]);
         
 
     }
 
-    
+    event_emit(EVENT_SEARCH_END, max_move, search_stats.nodes, 0);
     return max_move;
 }
 
@@ -603,6 +828,8 @@ int get_next_move1(int* tiles, int score, double* params){
         [3]: score_factor
      returns the best move from this state
     */
+    search_stats = (SearchStats){0};
+    search_stats.depth = params[0];
     int start_val = -1000000000;
     char powertiles[16];
     intrep_to_powerrep(powertiles, tiles);
@@ -623,7 +850,7 @@ int get_next_move1(int* tiles, int score, double* params){
         max_move = valid_moves[0];
     }
     else{return moves[0];}
-    
+    event_emit(EVENT_SEARCH_BEGIN, params[0], 0, 0);
 
     for(int i=0; i<num_valid_moves; i++){
         //printf("is_valid: %d\n", check_valid_move(&b, moves[i]));
@@ -636,17 +863,104 @@ int get_next_move1(int* tiles, int score, double* params){
             max_score = scores[i];
             max_move = valid_moves[i];
         }
+        search_stats.move_values[valid_moves[i]] = scores[i];
+        event_emit(EVENT_ROOT_MOVE, valid_moves[i], scores[i], 0);
 
         //printf("%d: %f\n, ", moves[i], scores[i]);
         
 
     }
 
-    
+    event_emit(EVENT_SEARCH_END, max_move, search_stats.nodes, 0);
     return max_move;
 
 
 }
+
+static int tt_next_move(int* tiles, int score, double* params, SearchFn search, bool reuse){
+    char powertiles[16];
+    intrep_to_powerrep(powertiles, tiles);
+
+    Board b;
+    for(int i =  0; i < 16; i ++){
+        b.tiles[i] = powertiles[i];
+    }
+    b.score = score;
+
+    search_stats = (SearchStats){0};
+    int depth = params[0];
+    search_stats.depth = depth;
+    tt_new_search(params);
+
+    int valid_moves[4];
+    int num_valid_moves = get_valid_moves(&b, valid_moves);
+    if(!num_valid_moves){return UP;}
+
+    // the moves' chance nodes are looked up first, if every one was searched deep enough (depth-1, or
+    // depth-3 with reuse) the move is answered from the table without searching
+    // the search that chose the last move stored depth-3 values for the chance nodes of each board its
+    // spawn can lead to, so with reuse every other move of a game is answered from the previous search
+    double cached[4];
+    int min_depth = reuse ? depth-3 : depth-1;
+    bool answered = min_depth > 0;
+    for(int i = 0; i < num_valid_moves && answered; i++){
+        Board b_cp;
+        copy_board_values(&b, &b_cp);
+        apply_move(&b_cp, valid_moves[i]);
+        uint64_t key;
+        answered = pack_board(&b_cp, &key) && tt_probe(key, b_cp.score, 1, min_depth, &cached[i]);
+    }
+    if(answered){
+        search_stats.tt_hits = num_valid_moves;
+        search_stats.depth = min_depth + 1;
+    }
+    event_emit(EVENT_SEARCH_BEGIN, search_stats.depth, 0, 0);
+
+    double max_score = -1000000000;
+    Move max_move = valid_moves[0];
+    for(int i=0; i<num_valid_moves; i++){
+        Board b_cp;
+        copy_board_values(&b, &b_cp);
+        apply_move(&b_cp, valid_moves[i]);
+        double move_score = answered ? cached[i] : search(&b_cp, params, false, depth-1);
+        if (max_score < move_score){
+            max_score = move_score;
+            max_move = valid_moves[i];
+        }
+        search_stats.move_values[valid_moves[i]] = move_score;
+        event_emit(EVENT_ROOT_MOVE, valid_moves[i], move_score, 0);
+    }
+    event_emit(EVENT_SEARCH_END, max_move, search_stats.nodes, 0);
+    return max_move;
+}
+
+int get_next_move_tt(int* tiles, int score, double* params){
+    /*get_next_move searching through the transposition table, same parameters
+        [0]: depth
+        [1]: path_penalty
+        [2]: loss_penalty
+        [3]: score_factor
+        [4]: reuse, 1 to answer a board the previous search reached after the move it chose from that
+             search's values, which are two plies shallower than a full search (see tt_next_move), 0 to search
+     nodes found again, in this search or a later one with the same parameters, are not searched again
+     returns the best move from this state, the same move get_next_move returns without reuse
+    */
+    return tt_next_move(tiles, score, params, expectiminmax_tt, params[4] != 0);
+}
+
+int get_next_move1_tt(int* tiles, int score, double* params){
+    /*get_next_move1 searching through the transposition table, same parameters
+        [0]: depth
+        [1]: path_penalty
+        [2]: loss_penalty
+        [3]: score_factor
+        [4]: num_trials
+        [5]: reuse, as get_next_move_tt's [4]
+     returns the best move from this state
+    */
+    return tt_next_move(tiles, score, params, expectiminmax1_tt, params[5] != 0);
+}
+
 double KL_divergence(double p, double q){
     //Gets the kl divergence KL(p||q) for two bernoulli variables
     // p is the probability of dist 1 being 1
@@ -703,7 +1017,7 @@ bool run_trial_until_win(Board* board, Move move, int* win_condition){
         if(!num_valid_moves){
             return 0;
         }
-        next_move = valid_moves[rand() % (num_valid_moves)];      
+        next_move = valid_moves[rollout_rand() % (num_valid_moves)];      
         apply_move(&b2, next_move);
         
         if(check_win_condition(&b2, win_condition)){return 1;}
@@ -726,9 +1040,10 @@ bool run_trial_for_n_moves(Board* board, Move move, int stop){
         if(!num_valid_moves){
             return 0;
         }
-        next_move = valid_moves[rand() % (num_valid_moves)];      
+        next_move = valid_moves[rollout_rand() % (num_valid_moves)];      
         apply_move(&b2, next_move);
         place_random_tile(&b2);
+        rollout_steps++;
 
     }
     return 1;
@@ -894,6 +1209,19 @@ void optimal_weights(double *w, double *means, double delta, int k){
     }
 
 }
+static void emit_stop(int trials, double statistic, int threshold_met, int* valid_moves, double* means, int* n, int k){
+    // the stopping decision of track_and_stop and track_and_stop1, and the arms it was made on
+    for(int i = 0; i < k; i++){
+        search_stats.arm_rollouts[valid_moves[i]] = n[i];
+        search_stats.move_values[valid_moves[i]] = means[i];
+    }
+    if(!events_enabled){return;}
+    event_record(EVENT_STOP, trials, statistic, threshold_met);
+    for(int i = 0; i < k; i++){
+        event_record(EVENT_ARM, valid_moves[i], means[i], n[i]);
+    }
+}
+
 int track_and_stop(Board* board, double* params){
     // track and stop algorithm described by Garivier and Kaufmann 2016
     int valid_moves[4];
@@ -919,7 +1247,7 @@ int track_and_stop(Board* board, double* params){
     double mean_best;
     double avg_means[k];
     //step2
-    double min_score;
+    double min_score = INFINITY; // reported if the trials run out before any stopping check
     double score;
     //step3
     int min_n;
@@ -929,7 +1257,7 @@ int track_and_stop(Board* board, double* params){
     int max_score_index;
     int max_score;
 
-    srand(time(NULL));
+    if(rollout_rng == NULL){srand(time(NULL));}
     if (k == 1){return valid_moves[0];}
 
     //step 0: run first trial
@@ -964,7 +1292,7 @@ int track_and_stop(Board* board, double* params){
 
         //if multiple best arms, draw one at random, no need to check stopping statistic
         if(num_max_arms>1){
-            best_index = max_arms[rand() % (num_max_arms)];
+            best_index = max_arms[rollout_rand() % (num_max_arms)];
             t+=1;
             S[best_index] += run_trial_for_n_moves(board, valid_moves[best_index], num_games_to_look_ahead);
             n[best_index]++;
@@ -990,11 +1318,7 @@ int track_and_stop(Board* board, double* params){
 
         if(min_score > log(2*t*(k-1)/confidence)){ //log((log(t)+1)/delta) is alternative stopping point
             // stop
-            printf("Min Score _thresh met: %f\n", min_score);
-            for(int i = 0; i < k; i ++){
-                printf("%f, ", means[i]);
-            }
-            printf("\n time %d,\n", t);
+            emit_stop(t, min_score, 1, valid_moves, means, n, k);
             return valid_moves[best_index];
         }
 
@@ -1037,11 +1361,7 @@ int track_and_stop(Board* board, double* params){
         continue;
         
     }
-    printf("Min Score: %f\n", min_score);
-    for(int i = 0; i < k; i ++){
-        printf("%f, ", means[i]);
-    }
-    printf("\n time %d,\n", max_trials);
+    emit_stop(max_trials, min_score, 0, valid_moves, means, n, k);
     return valid_moves[best_index];
 
     
@@ -1069,8 +1389,8 @@ int get_MCTS_next_move(int* tiles, int score, double* params){
         b.tiles[i] = powertiles[i];
     }
     b.score = score;
+    search_stats = (SearchStats){0};
 
-    
     return track_and_stop(&b, params);
 }
 
@@ -1103,7 +1423,7 @@ int track_and_stop1(Board* board, double* params){
     double mean_best;
     double avg_means[k];
     //step2
-    double min_score;
+    double min_score = INFINITY; // reported if the trials run out before any stopping check
     double score;
     //step3
     int min_n;
@@ -1113,15 +1433,18 @@ int track_and_stop1(Board* board, double* params){
     int max_score_index;
     int max_score;
 
-    srand(time(NULL));
+    if(rollout_rng == NULL){srand(time(NULL));}
     if (k == 1){return valid_moves[0];}
 
     //step 00: check win condition, increment if necessary
     while(check_win_condition(board, win_condition)){increment_win_condition(win_condition);}
-    for(int j =0; j < 8; j++){
-            printf("%d", win_condition[j]);
+    if(events_enabled){
+        int packed_condition = 0;
+        for(int j = 0; j < 8; j++){
+            packed_condition |= (win_condition[j] & 0xF) << (4*j);
         }
-        printf("\n");
+        event_record(EVENT_WIN_CONDITION, packed_condition, 0, 0);
+    }
 
     //step 0: run first trial
     for(int i = 0; i < k; i++){
@@ -1155,7 +1478,7 @@ int track_and_stop1(Board* board, double* params){
 
         //if multiple best arms, draw one at random, no need to check stopping statistic
         if(num_max_arms>1){
-            best_index = max_arms[rand() % (num_max_arms)];
+            best_index = max_arms[rollout_rand() % (num_max_arms)];
             t+=1;
             S[best_index] += run_trial_until_win(board, valid_moves[best_index], win_condition);
             n[best_index]++;
@@ -1181,11 +1504,7 @@ int track_and_stop1(Board* board, double* params){
 
         if(min_score > log(2*t*(k-1)/confidence)){ //log((log(t)+1)/delta) is alternative stopping point
             // stop
-            printf("Min Score _thresh met: %f\n", min_score);
-            for(int i = 0; i < k; i ++){
-                printf("%f, ", means[i]);
-            }
-            printf("\n time %d,\n", t);
+            emit_stop(t, min_score, 1, valid_moves, means, n, k);
             return valid_moves[best_index];
         }
 
@@ -1228,11 +1547,7 @@ int track_and_stop1(Board* board, double* params){
         continue;
         
     }
-    printf("Min Score: %f\n", min_score);
-    for(int i = 0; i < k; i ++){
-        printf("%f, ", means[i]);
-    }
-    printf("\n time %d,\n", max_trials);
+    emit_stop(max_trials, min_score, 0, valid_moves, means, n, k);
     return valid_moves[best_index];
 
     
@@ -1260,8 +1575,8 @@ int get_MCTS_next_move1(int* tiles, int score, double* params){
         b.tiles[i] = powertiles[i];
     }
     b.score = score;
+    search_stats = (SearchStats){0};
 
-    
     return track_and_stop1(&b, params);
 }
 
@@ -1284,7 +1599,6 @@ int run_EM_trial(Board* board, Move move, double* params){
         num_valid_moves = get_valid_moves(&b2, valid_moves);
         
         if(!num_valid_moves){
-            printf("score: %d", b2.score);
             return b2.score;
         }
         max_score = 0;
@@ -1301,6 +1615,7 @@ int run_EM_trial(Board* board, Move move, double* params){
         next_move = valid_moves[max_score_index];
         apply_move(&b2, next_move);
         place_random_tile(&b2);
+        rollout_steps++;
     }
 }
 
@@ -1324,14 +1639,19 @@ int get_MCTS_next_move2(int* tiles, int score, double* params){
     int valid_moves[4];
     int k = get_valid_moves(&b, valid_moves);
 
-    int scores[k];
-    int max_score = 0;
+    // every arm gets at least one rollout
+    int n = (num_trials > 1) ? num_trials : 1;
+    int trials[4] = {n, n, n, n};
+    long long scores[4];
+    uint64_t batch_start = event_clock();
+    search_stats = (SearchStats){0};
+    run_rollouts(&b, valid_moves, trials, k, ROLLOUT_RANDOM, NULL, scores);
+    for(int i = 0; i < k; i++){search_stats.arm_rollouts[valid_moves[i]] = n;}
+    long long max_score = 0;
     int max_score_index = 0;
     for(int i = 0; i < k; i++){
-        scores[i] = run_random_trial(&b, valid_moves[i]);
-        for(int t = 1; t < num_trials; t++){
-            scores[i] += run_random_trial(&b, valid_moves[i]);
-        }
+        event_rollouts(batch_start, n, scores[i]);
+        search_stats.move_values[valid_moves[i]] = (double)scores[i] / n;
         if(scores[i] > max_score){
             max_score = scores[i];
             max_score_index = i;
@@ -1361,14 +1681,19 @@ int get_MCTS_next_move3(int* tiles, int score, double* params){
     int valid_moves[4];
     int k = get_valid_moves(&b, valid_moves);
 
-    int scores[k];
-    int max_score = -1000000000;
+    // every arm gets at least one rollout
+    int n = (num_trials > 1) ? num_trials : 1;
+    int trials[4] = {n, n, n, n};
+    long long scores[4];
+    uint64_t batch_start = event_clock();
+    search_stats = (SearchStats){0};
+    run_rollouts(&b, valid_moves, trials, k, ROLLOUT_EM, params, scores);
+    for(int i = 0; i < k; i++){search_stats.arm_rollouts[valid_moves[i]] = n;}
+    long long max_score = -1000000000;
     int max_score_index = 0;
     for(int i = 0; i < k; i++){
-        scores[i] = run_EM_trial(&b, valid_moves[i], params);
-        for(int t = 1; t < num_trials; t++){
-            scores[i] += run_EM_trial(&b, valid_moves[i], params);
-        }
+        event_rollouts(batch_start, n, scores[i]);
+        search_stats.move_values[valid_moves[i]] = (double)scores[i] / n;
         if(scores[i] > max_score){
             max_score = scores[i];
             max_score_index = i;
@@ -1383,6 +1708,7 @@ int get_MCTS_next_move3(int* tiles, int score, double* params){
 
 
 
+#ifndef TWENCY48_NO_MAIN
 int main(){
     double means[4] = {0.2,0.4,0.7,0.6};
     int best = 1;
@@ -1419,3 +1745,4 @@ int main(){
 
 
 }
+#endif
@@ -0,0 +1,144 @@
+#include <pthread.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "packed.h"
+
+// Lookup tables for packed boards, see packed.h
+// Built once per process, or once per machine when placed in a shared memory segment with
+// move_tables_attach_shared, in which case every attached process reads the same copy. The segment
+// header records the layout of the tables, so a segment left by a build with other tables is refused.
+
+const MoveTables* move_tables = NULL;
+static MoveTables* local_tables = NULL;
+static pthread_once_t tables_once = PTHREAD_ONCE_INIT;
+
+static void move_row_left(int* row, int* gained, bool* unpackable){
+    // same rules as apply_move for one row, merging towards row[0]
+    for(int t1 = 0; t1 <= 2; t1++){
+        for(int t2 = t1 + 1; t2 <= 3; t2++){
+            if(row[t2] != 0){
+                if(row[t2] == row[t1]){
+                    if(row[t1] == 15){
+                        // 32768 + 32768 cannot be packed, the row is left with a 32768 and nothing is
+                        // gained, callers check move_unpackable_packed and fall back to unpacked boards
+                        *unpackable = 1;
+                        row[t2] = 0;
+                        break;
+                    }
+                    row[t1]++;
+                    row[t2] = 0;
+                    *gained += 2 << (row[t1]-1);
+                    break;
+                }
+                else if(row[t1] == 0){
+                    row[t1] = row[t2];
+                    row[t2] = 0;
+                }
+                else{
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void build_tables(MoveTables* t){
+    for(int r = 0; r < 65536; r++){
+        int row[4], rev[4];
+        for(int j = 0; j < 4; j++){
+            row[j] = (r >> (4*j)) & 0xF;
+            rev[j] = (r >> (4*(3-j))) & 0xF;
+        }
+
+        uint32_t fwd = 0, back = 0;
+        for(int j = 0; j < 3; j++){
+            int a = row[j] ? (1 << row[j]) : 0;
+            int b = row[j+1] ? (1 << row[j+1]) : 0;
+            fwd += (a > b) ? a - b : 0;
+            back += (b > a) ? b - a : 0;
+        }
+        t->path_fwd[r] = fwd;
+        t->path_rev[r] = back;
+
+        int gained = 0;
+        bool unpackable = 0;
+        move_row_left(row, &gained, &unpackable);
+        t->left[r] = row[0] | (row[1] << 4) | (row[2] << 8) | (row[3] << 12);
+        t->score_left[r] = gained;
+
+        gained = 0;
+        move_row_left(rev, &gained, &unpackable);
+        t->right[r] = rev[3] | (rev[2] << 4) | (rev[1] << 8) | (rev[0] << 12);
+        t->score_right[r] = gained;
+        t->unpackable[r] = unpackable;
+    }
+}
+
+static void init_local_tables(){
+    if(move_tables != NULL){return;}
+    local_tables = malloc(sizeof(MoveTables));
+    build_tables(local_tables);
+    move_tables = local_tables;
+}
+
+void move_tables_init(){
+    // builds the tables if this process has none yet, safe to call from any thread
+    pthread_once(&tables_once, init_local_tables);
+}
+
+#define MOVE_TABLES_MAGIC 0x7362617438347774ULL // "tw48tabs"
+#define MOVE_TABLES_VERSION 2     // 2 added unpackable
+
+typedef struct{
+    uint64_t state;     // 0 new, 1 being built, 2 ready
+    uint64_t magic;     // MOVE_TABLES_MAGIC, written with version and size before state is 2
+    uint64_t version;   // MOVE_TABLES_VERSION
+    uint64_t size;      // sizeof(MoveTables)
+    uint64_t reserved[4];
+} SharedTablesHeader;
+
+int move_tables_attach_shared(const char* name){
+    /*uses the tables in the POSIX shared memory segment name (eg. "/twency48_tables"), the first
+     process to attach builds them
+     a segment left by a build with other tables, or whose creator died while building them (not ready
+     after SHARED_WAIT_POLLS polls), is not used; shm_unlink it to start over
+     returns 1 on success, the process keeps its own tables on failure
+    */
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if(fd < 0){return 0;}
+    size_t size = sizeof(SharedTablesHeader) + sizeof(MoveTables);
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (st.st_size == 0 && ftruncate(fd, size) != 0) || (st.st_size != 0 && (size_t)st.st_size < size)){
+        close(fd);
+        return 0;
+    }
+    SharedTablesHeader* header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(header == MAP_FAILED){return 0;}
+
+    MoveTables* tables = (MoveTables*)(header + 1);
+    uint64_t expected = 0;
+    if(__atomic_compare_exchange_n(&header->state, &expected, 1, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        build_tables(tables);
+        header->magic = MOVE_TABLES_MAGIC;
+        header->version = MOVE_TABLES_VERSION;
+        header->size = sizeof(MoveTables);
+        __atomic_store_n(&header->state, 2, __ATOMIC_RELEASE);
+    }
+    bool ready = 0;
+    for(int wait = 0; wait < SHARED_WAIT_POLLS; wait++){
+        ready = __atomic_load_n(&header->state, __ATOMIC_ACQUIRE) == 2;
+        if(ready){break;}
+        usleep(100);
+    }
+    if(!ready || header->magic != MOVE_TABLES_MAGIC || header->version != MOVE_TABLES_VERSION || header->size != sizeof(MoveTables)){
+        munmap(header, size);
+        return 0;
+    }
+    // set before the once so move_tables_init will not build or switch back to private tables
+    move_tables = tables;
+    pthread_once(&tables_once, init_local_tables);
+    return 1;
+}
@@ -0,0 +1,149 @@
+#ifndef TWENCY48_PACKED_H
+#define TWENCY48_PACKED_H
+
+#include "twency48.h"
+
+// Packed boards
+// A board packed into 64 bits (see pack_board), tile i in bits 4i to 4i+3, so row r is the 16 bits
+// starting at 16r. Moves work a row at a time through lookup tables; up and down transpose the
+// board and move its columns as rows.
+
+typedef struct{
+    uint16_t left[65536];       // row after moving left (towards tile 0 of the row)
+    uint16_t right[65536];
+    uint32_t score_left[65536]; // score gained moving the row left
+    uint32_t score_right[65536];
+    uint32_t path_fwd[65536];   // sum of max(0, t[j] - t[j+1]) over the row in int rep, the snake path penalty
+    uint32_t path_rev[65536];   // the same walking the row from tile 3 to tile 0
+    uint8_t unpackable[65536];  // 1 if moving the row either way merges two 32768s, see move_unpackable_packed
+} MoveTables;
+
+extern const MoveTables* move_tables;
+
+static inline uint64_t transpose_packed(uint64_t x){
+    // swaps rows and columns
+    uint64_t a1 = x & 0xF0F00F0FF0F00F0FULL;
+    uint64_t a2 = x & 0x0000F0F00000F0F0ULL;
+    uint64_t a3 = x & 0x0F0F00000F0F0000ULL;
+    uint64_t a = a1 | (a2 << 12) | (a3 >> 12);
+    uint64_t b1 = a & 0xFF00FF0000FF00FFULL;
+    uint64_t b2 = a & 0x00FF00FF00000000ULL;
+    uint64_t b3 = a & 0x00000000FF00FF00ULL;
+    return b1 | (b2 >> 24) | (b3 << 24);
+}
+
+static inline uint64_t move_rows(uint64_t board, const uint16_t* rows, const uint32_t* scores, int* gained){
+    uint64_t result = 0;
+    for(int r = 0; r < 4; r++){
+        uint16_t row = board >> (16*r);
+        result |= (uint64_t)rows[row] << (16*r);
+        *gained += scores[row];
+    }
+    return result;
+}
+
+static inline uint64_t apply_move_packed(uint64_t board, int move, int* gained){
+    // returns the board after move, adding the merged tiles to gained
+    // the board is unchanged if the move is not valid
+    const MoveTables* t = move_tables;
+    switch(move){
+        case LEFT:
+            return move_rows(board, t->left, t->score_left, gained);
+        case RIGHT:
+            return move_rows(board, t->right, t->score_right, gained);
+        case UP:
+            return transpose_packed(move_rows(transpose_packed(board), t->left, t->score_left, gained));
+        case DOWN:
+            return transpose_packed(move_rows(transpose_packed(board), t->right, t->score_right, gained));
+    }
+    return board;
+}
+
+static inline bool move_unpackable_packed(uint64_t board, int move){
+    // 1 if move merges two 32768s: a packed board cannot hold the 65536, so apply_move_packed leaves a
+    // 32768 in its place and gains nothing for it, and callers that need the real result move the
+    // unpacked board instead, as they do for boards with tiles past 32768
+    uint64_t fifteens = board & (board >> 1) & (board >> 2) & (board >> 3) & 0x1111111111111111ULL;
+    if(__builtin_popcountll(fifteens) < 2){return 0;}
+    uint64_t rows = (move == LEFT || move == RIGHT) ? board : transpose_packed(board);
+    for(int r = 0; r < 4; r++){
+        if(move_tables->unpackable[(rows >> (16*r)) & 0xFFFF]){return 1;}
+    }
+    return 0;
+}
+
+static inline int count_empty_packed(uint64_t board){
+    // number of 0 tiles
+    uint64_t x = board | (board >> 1);
+    x |= x >> 2;
+    x &= 0x1111111111111111ULL;
+    return 16 - __builtin_popcountll(x);
+}
+
+static inline bool has_valid_move_packed(uint64_t board){
+    if(count_empty_packed(board)){return 1;}
+    // full board, a move is valid only if two neighbours match
+    uint64_t horizontal = board ^ (board >> 4);
+    uint64_t t = transpose_packed(board);
+    uint64_t vertical = t ^ (t >> 4);
+    // a zero nibble at position 0-2 of a row means tiles j and j+1 match
+    uint64_t mask = 0x0FFF0FFF0FFF0FFFULL;
+    for(int i = 0; i < 16; i++){
+        if(((mask >> (4*i)) & 0xF) == 0){continue;}
+        if(((horizontal >> (4*i)) & 0xF) == 0 || ((vertical >> (4*i)) & 0xF) == 0){return 1;}
+    }
+    return 0;
+}
+
+static inline uint32_t path_penalty_packed(uint64_t board){
+    // path penalty of estimate_score, snake path 3,2,1,0,4,5,6,7,11,10,9,8,12,13,14,15
+    const MoveTables* t = move_tables;
+    uint32_t pen = t->path_rev[board & 0xFFFF] + t->path_fwd[(board >> 16) & 0xFFFF]
+                 + t->path_rev[(board >> 32) & 0xFFFF] + t->path_fwd[(board >> 48) & 0xFFFF];
+    static const int links[3][2] = {{0, 4}, {7, 11}, {8, 12}};
+    for(int i = 0; i < 3; i++){
+        int a = (board >> (4*links[i][0])) & 0xF;
+        int b = (board >> (4*links[i][1])) & 0xF;
+        if(a > b){
+            pen += (1u << a) - (b ? (1u << b) : 0);
+        }
+    }
+    return pen;
+}
+
+static inline int greedy_move_packed(uint64_t board, double* params){
+    // the move with the best estimate_score one move ahead (params laid out as in get_next_move, [1]
+    // and [3] are used), -1 if there is none
+    int best = -1;
+    double best_value = 0;
+    for(int m = 0; m < 4; m++){
+        int gained = 0;
+        uint64_t child = apply_move_packed(board, m, &gained);
+        if(child == board){continue;}
+        double value = params[3] * gained - params[1] * path_penalty_packed(child);
+        if(best < 0 || value > best_value){
+            best = m;
+            best_value = value;
+        }
+    }
+    return best;
+}
+
+static inline int corner_move_packed(uint64_t board){
+    // the first valid move of down, right, left, up, keeping the largest tiles towards tile 15, the
+    // end of the snake path, -1 if there is none
+    static const int corner_order[4] = {DOWN, RIGHT, LEFT, UP};
+    for(int i = 0; i < 4; i++){
+        int gained = 0;
+        if(apply_move_packed(board, corner_order[i], &gained) != board){
+            return corner_order[i];
+        }
+    }
+    return -1;
+}
+
+// movetab.c
+void move_tables_init();
+int move_tables_attach_shared(const char* name);
+
+#endif
@@ -0,0 +1,177 @@
+#include <pthread.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "twency48.h"
+
+// Hardware counters
+// perf_enable(PERF_CALLS) makes engine_move count cycles, instructions, L1d and last level cache
+// misses, branch misses and cpu time over every call, and leave the deltas in search_stats.perf.
+// The counters are opened per thread with perf_event_open as one group, so one read() gets them
+// all. They count user space only, which the default perf_event_paranoid setting allows. Counters
+// the cpu or kernel does not have are left out (virtual machines often have no PMU, leaving only
+// the cpu time), see PerfStats.available.
+// PERF_PHASES also splits the counts by PerfPhase. Every phase switch costs a read(), around a
+// microsecond, which is large next to a batch of leaves, so phase figures are for comparing runs
+// with each other rather than for absolute costs. Move generation is interleaved with every node,
+// too finely to be a phase of its own, and is counted with the rest of the search.
+// Rollouts played by the pool's workers (pool.c) for a counted call are counted on the worker and
+// added to the call's PERF_PHASE_ROLLOUTS, so with rollout_pool_init(n > 1) the counts, cpu time
+// included, are summed over threads rather than measured against wall time.
+
+static const struct{uint32_t type; uint64_t config;} perf_events[NUM_PERF_COUNTERS] = {
+    [PERF_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    [PERF_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    [PERF_L1D_MISSES] = {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    [PERF_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    [PERF_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    [PERF_TASK_CLOCK] = {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+};
+
+static const char* perf_names[NUM_PERF_COUNTERS] = {
+    [PERF_CYCLES] = "cycles",
+    [PERF_INSTRUCTIONS] = "instructions",
+    [PERF_L1D_MISSES] = "l1d_misses",
+    [PERF_LLC_MISSES] = "llc_misses",
+    [PERF_BRANCH_MISSES] = "branch_misses",
+    [PERF_TASK_CLOCK] = "task_clock_ns",
+};
+
+typedef struct{
+    int leader;                     // group fd, -1 if no counter could be opened
+    int fds[NUM_PERF_COUNTERS];
+    int slots[NUM_PERF_COUNTERS];   // position of each counter in a group read, -1 if it is not open
+    int num_open;
+    uint32_t available;
+} PerfGroup;
+
+volatile int perf_level = PERF_OFF;
+__thread int perf_phases_on = 0;
+static __thread PerfGroup* group = NULL;
+static __thread int perf_depth = 0;                 // nested perf_begin calls
+static __thread int current_phase;
+static __thread uint64_t phase_start[NUM_PERF_COUNTERS];
+static __thread PerfStats call_stats;
+static pthread_key_t group_key;
+static pthread_once_t group_key_once = PTHREAD_ONCE_INIT;
+
+static void close_group(void* owned){
+    // thread exit
+    PerfGroup* g = owned;
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++){
+        if(g->fds[c] >= 0){close(g->fds[c]);}
+    }
+    free(g);
+}
+
+static void make_group_key(){
+    pthread_key_create(&group_key, close_group);
+}
+
+static PerfGroup* open_group(){
+    pthread_once(&group_key_once, make_group_key);
+    PerfGroup* g = calloc(1, sizeof(PerfGroup));
+    if(g == NULL){return NULL;}
+    g->leader = -1;
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++){
+        g->fds[c] = -1;
+        g->slots[c] = -1;
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = perf_events[c].type;
+        attr.config = perf_events[c].config;
+        attr.read_format = PERF_FORMAT_GROUP;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        int fd = syscall(SYS_perf_event_open, &attr, 0, -1, g->leader, 0);
+        if(fd < 0){continue;}
+        if(g->leader < 0){g->leader = fd;}
+        g->fds[c] = fd;
+        g->slots[c] = g->num_open++;
+        g->available |= 1u << c;
+    }
+    pthread_setspecific(group_key, g);
+    return g;
+}
+
+static bool read_counters(uint64_t* counts){
+    // current value of every counter of the thread's group, 0 for the ones not open
+    struct{uint64_t nr; uint64_t values[NUM_PERF_COUNTERS];} data;
+    if(group->leader < 0 || read(group->leader, &data, sizeof(data)) < (ssize_t)sizeof(uint64_t)){return 0;}
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++){
+        counts[c] = (group->slots[c] >= 0 && (uint64_t)group->slots[c] < data.nr) ? data.values[group->slots[c]] : 0;
+    }
+    return 1;
+}
+
+static void close_phase(){
+    // adds the counts since the phase started to it and starts the next one now
+    uint64_t now[NUM_PERF_COUNTERS];
+    if(!read_counters(now)){return;}
+    for(int c = 0; c < NUM_PERF_COUNTERS; c++){
+        call_stats.counts[current_phase][c] += now[c] - phase_start[c];
+        phase_start[c] = now[c];
+    }
+}
+
+int perf_enable(int level){
+    /*level: one of PerfLevel, applies to every thread
+     returns the PerfStats.available bits of the calling thread, 0 if no counter can be opened
+    */
+    perf_level = (level == PERF_CALLS || level == PERF_PHASES) ? level : PERF_OFF;
+    if(group == NULL){group = open_group();}
+    return (group != NULL) ? group->available : 0;
+}
+
+const char* perf_counter_name(int counter){
+    if(counter < 0 || counter >= NUM_PERF_COUNTERS){return NULL;}
+    return perf_names[counter];
+}
+
+void perf_begin(){
+    // starts counting a call on the calling thread, see perf_end
+    if(perf_depth++ > 0){return;}
+    call_stats = (PerfStats){0};
+    if(perf_level == PERF_OFF){return;}
+    if(group == NULL){group = open_group();}
+    if(group == NULL || !read_counters(phase_start)){return;}
+    call_stats.available = group->available;
+    current_phase = PERF_PHASE_SEARCH;
+    perf_phases_on = (perf_level == PERF_PHASES);
+}
+
+void perf_end(PerfStats* stats){
+    // stops counting and copies the counts since perf_begin to stats, only the outermost call counts
+    if(--perf_depth > 0){
+        *stats = (PerfStats){0};
+        return;
+    }
+    if(call_stats.available){close_phase();}
+    perf_phases_on = 0;
+    *stats = call_stats;
+}
+
+bool perf_counting(){
+    // 1 if the calling thread is inside a call being counted
+    return perf_depth > 0 && call_stats.available;
+}
+
+void perf_add(const PerfStats* stats){
+    // adds counts taken on other threads for the call being counted on the calling thread
+    if(!perf_counting()){return;}
+    for(int p = 0; p < NUM_PERF_PHASES; p++){
+        for(int c = 0; c < NUM_PERF_COUNTERS; c++){call_stats.counts[p][c] += stats->counts[p][c];}
+    }
+}
+
+int perf_switch_phase(int phase){
+    // use perf_phase, returns the phase that was running
+    int previous = current_phase;
+    if(phase != previous){
+        close_phase();
+        current_phase = phase;
+    }
+    return previous;
+}
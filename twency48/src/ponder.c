@@ -0,0 +1,207 @@
+#include <pthread.h>
+#include <string.h>
+#include "twency48.h"
+
+// Ponder mode
+// After a move is returned, a background thread searches the positions the game can be in when the
+// next call arrives (the chosen move followed by every possible spawn), most probable spawn first.
+// When the real board arrives the background search is stopped, and if the board was pondered its
+// finished move scores are reused, so only moves the ponder thread did not reach are searched.
+// There is one ponder state per process, meant for a single game. Calls are serialized by ponder_lock,
+// so games pondering in parallel are safe, but each call replaces the others' pondered boards and they
+// mostly search from scratch.
+
+#define MAX_PONDER_ENTRIES 30 // 15 empty tiles * 2 tile values
+
+typedef struct{
+    Board board;            // position after move + spawn
+    int valid_moves[4];
+    int num_valid_moves;
+    double scores[4];       // scores of valid_moves[0:num_done]
+    int num_done;
+} PonderEntry;
+
+static struct{
+    pthread_t thread;
+    bool running;
+    volatile int stop;
+
+    SearchFn search;
+    double params[5];
+    int num_params;
+
+    PonderEntry entries[MAX_PONDER_ENTRIES];
+    int num_entries;
+} ponder = {0};
+
+static pthread_mutex_t ponder_lock = PTHREAD_MUTEX_INITIALIZER; // held by ponder_stop and ponder_next_move
+
+
+static void* ponder_worker(void* arg){
+    // entries are already sorted by spawn probability
+    search_abort = &ponder.stop;
+    for(int e = 0; e < ponder.num_entries; e++){
+        PonderEntry* entry = &ponder.entries[e];
+        for(int i = 0; i < entry->num_valid_moves; i++){
+            Board b_cp;
+            copy_board_values(&entry->board, &b_cp);
+            apply_move(&b_cp, entry->valid_moves[i]);
+            double score = ponder.search(&b_cp, ponder.params, false, ponder.params[0]-1);
+            if(ponder.stop){
+                // score is incomplete, discard it
+                return NULL;
+            }
+            entry->scores[i] = score;
+            entry->num_done++;
+        }
+    }
+    return NULL;
+}
+
+static void stop_worker(){
+    // stops the background search, results found so far are kept for the next call
+    if(!ponder.running){return;}
+    ponder.stop = 1;
+    pthread_join(ponder.thread, NULL);
+    ponder.running = false;
+}
+
+void ponder_stop(){
+    pthread_mutex_lock(&ponder_lock);
+    stop_worker();
+    pthread_mutex_unlock(&ponder_lock);
+}
+
+static void ponder_start(Board* after_move){
+    // queue every spawn on the board after the chosen move, 2s before 4s, and start the worker
+    // spawns that end the game are not queued, so no thread is left running after the last move
+    int empty_tiles[16];
+    int empty_len = get_empty_tiles(after_move, empty_tiles);
+    ponder.num_entries = 0;
+    if(!empty_len){return;}
+
+    for(int v = 1; v <= 2; v++){
+        for(int i = 0; i < empty_len; i++){
+            PonderEntry* entry = &ponder.entries[ponder.num_entries];
+            copy_board_values(after_move, &entry->board);
+            set_tile(&entry->board, empty_tiles[i], v);
+            entry->num_valid_moves = get_valid_moves(&entry->board, entry->valid_moves);
+            entry->num_done = 0;
+            if(entry->num_valid_moves){
+                ponder.num_entries++;
+            }
+        }
+    }
+    if(!ponder.num_entries){return;}
+
+    ponder.stop = 0;
+    if(pthread_create(&ponder.thread, NULL, ponder_worker, NULL) == 0){
+        ponder.running = true;
+    }
+}
+
+static PonderEntry* ponder_lookup(Board* board, SearchFn search, double* params, int num_params){
+    // finds the pondered entry for board, if it was pondered with the same search and parameters
+    if(ponder.search != search || ponder.num_params != num_params){return NULL;}
+    if(memcmp(ponder.params, params, num_params * sizeof(double)) != 0){return NULL;}
+
+    for(int e = 0; e < ponder.num_entries; e++){
+        PonderEntry* entry = &ponder.entries[e];
+        if(entry->board.score == board->score && memcmp(entry->board.tiles, board->tiles, 16) == 0){
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+static int choose_move(int* tiles, int score, double* params, SearchFn search, int num_params){
+    // ponder_next_move with ponder_lock held
+    stop_worker();
+
+    char powertiles[16];
+    intrep_to_powerrep(powertiles, tiles);
+
+    Board b;
+    for(int i =  0; i < 16; i ++){
+        b.tiles[i] = powertiles[i];
+    }
+    b.score = score;
+
+    int valid_moves[4];
+    int num_valid_moves = get_valid_moves(&b, valid_moves);
+    if(!num_valid_moves){
+        // game over, the ponder thread was stopped above and none is started
+        ponder.num_entries = 0;
+        return UP;
+    }
+
+    double scores[4];
+    int num_done = 0;
+    PonderEntry* entry = ponder_lookup(&b, search, params, num_params);
+    if(entry != NULL){
+        // valid moves are generated in the same order, so pondered scores line up with ours
+        num_done = entry->num_done;
+        for(int i = 0; i < num_done; i++){
+            scores[i] = entry->scores[i];
+        }
+    }
+    for(int i = num_done; i < num_valid_moves; i++){
+        Board b_cp;
+        copy_board_values(&b, &b_cp);
+        apply_move(&b_cp, valid_moves[i]);
+        scores[i] = search(&b_cp, params, false, params[0]-1);
+    }
+
+    double max_score = -1000000000;
+    Move max_move = valid_moves[0];
+    Board after_move;
+    for(int i = 0; i < num_valid_moves; i++){
+        if(max_score < scores[i]){
+            max_score = scores[i];
+            max_move = valid_moves[i];
+        }
+    }
+
+    ponder.search = search;
+    ponder.num_params = num_params;
+    memcpy(ponder.params, params, num_params * sizeof(double));
+    copy_board_values(&b, &after_move);
+    apply_move(&after_move, max_move);
+    ponder_start(&after_move);
+
+    return max_move;
+}
+
+static int ponder_next_move(int* tiles, int score, double* params, SearchFn search, int num_params){
+    pthread_mutex_lock(&ponder_lock);
+    int move = choose_move(tiles, score, params, search, num_params);
+    pthread_mutex_unlock(&ponder_lock);
+    return move;
+}
+
+int get_next_move_ponder(int* tiles, int score, double* params){
+    /*get_next_move with ponder mode, same parameters
+        [0]: depth
+        [1]: path_penalty
+        [2]: loss_penalty
+        [3]: score_factor
+     returns the best move from this state and keeps searching likely next states until the next call
+     call ponder_stop (ExpectiMax7/8.stop_ponder) when the game is over, or the thread keeps searching boards that will not arrive
+     the ponder state is shared by the process, so pondering only pays off for one game at a time
+    */
+    return ponder_next_move(tiles, score, params, expectiminmax, 4);
+}
+
+int get_next_move1_ponder(int* tiles, int score, double* params){
+    /*get_next_move1 with ponder mode, same parameters
+        [0]: depth
+        [1]: path_penalty
+        [2]: loss_penalty
+        [3]: score_factor
+        [4]: num_trials
+     returns the best move from this state and keeps searching likely next states until the next call
+     call ponder_stop (ExpectiMax7/8.stop_ponder) when the game is over, or the thread keeps searching boards that will not arrive
+     the ponder state is shared by the process, so pondering only pays off for one game at a time
+    */
+    return ponder_next_move(tiles, score, params, expectiminmax1, 5);
+}
@@ -0,0 +1,210 @@
+#include <pthread.h>
+#include <string.h>
+#include "twency48.h"
+
+// Rollout pool
+// run_rollouts plays a number of rollouts after each of a few moves (the arms of get_MCTS_next_move2/3,
+// or the rollouts of estimate_score1) and sums their scores per arm. With rollout_pool_init(n) the
+// rollouts are split into chunks shared between n - 1 persistent workers and the calling thread,
+// otherwise (the default) they are played on the calling thread as before.
+// Each chunk plays with its own Rng, seeded from one rollout_rand() per call and the chunk, so rollouts use
+// no shared random state and a call gives the same sums whichever thread plays which chunk. The
+// workers' RolloutStats, rollout_steps and hardware counters (when the call is counted, see perf.c)
+// are added to the calling thread's, and they follow its search_abort.
+// The pool runs one call at a time. A call made while it is busy (another thread's search, or a
+// rollout inside a pooled rollout) is played on the calling thread.
+
+#define MAX_ARMS 4
+
+typedef struct{
+    Board board;
+    const int* moves;
+    const int* trials;      // rollouts per arm
+    int num_arms;
+    int policy;
+    double* params;
+    volatile int* abort;
+    uint64_t seed;
+    int chunk_size;
+    int chunk_starts[MAX_ARMS + 1];  // first chunk of each arm, the last entry is the number of chunks
+    int next_chunk;         // taken with __atomic_fetch_add
+    int workers;            // workers on the job, guarded by pool_lock
+    long long sums[MAX_ARMS];
+    RolloutStats stats[NUM_ROLLOUT_POLICIES];
+    bool count_perf;        // the calling thread is counting, workers count their chunks into perf
+    PerfStats perf;         // everything in PERF_PHASE_ROLLOUTS
+} RolloutJob;
+
+static pthread_mutex_t pool_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t work_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t done_cond = PTHREAD_COND_INITIALIZER;
+static pthread_mutex_t submit_lock = PTHREAD_MUTEX_INITIALIZER;   // held by the call using the pool
+static RolloutJob* current_job = NULL;
+static uint64_t generation = 0;     // jobs posted, so a worker joins each job once
+static pthread_t* workers = NULL;
+static int num_workers = 0;
+static bool stopping = 0;
+static __thread bool in_pool_worker = 0;
+
+static void play_chunks(RolloutJob* job){
+    // plays chunks until none are left, then adds what this thread played to the job
+    long long sums[MAX_ARMS] = {0};
+    RolloutStats before[NUM_ROLLOUT_POLICIES], after[NUM_ROLLOUT_POLICIES];
+    get_rollout_stats(before);
+    volatile int* abort = search_abort;
+    search_abort = job->abort;
+    bool count_perf = job->count_perf && in_pool_worker;
+    PerfStats perf = {0};
+    if(count_perf){
+        perf_begin();
+        perf_phases_on = 0; // all of it is rollouts
+    }
+    int num_chunks = job->chunk_starts[job->num_arms];
+    while(true){
+        int c = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+        if(c >= num_chunks){break;}
+        int arm = 0;
+        while(c >= job->chunk_starts[arm + 1]){arm++;}
+        int first = (c - job->chunk_starts[arm]) * job->chunk_size;
+        int last = (first + job->chunk_size < job->trials[arm]) ? first + job->chunk_size : job->trials[arm];
+
+        Rng rng = {job->seed ^ ((uint64_t)c * 0xd1b54a32d192ed03ULL)};
+        Rng* saved = rollout_rng;
+        rollout_rng = &rng;
+        for(int t = first; t < last; t++){
+            sums[arm] += run_rollout(&job->board, job->moves[arm], job->policy, job->params);
+        }
+        rollout_rng = saved;
+    }
+    search_abort = abort;
+    get_rollout_stats(after);
+    if(count_perf){perf_end(&perf);}
+
+    pthread_mutex_lock(&pool_lock);
+    for(int a = 0; a < job->num_arms; a++){job->sums[a] += sums[a];}
+    // the calling thread's own counters already have its rollouts
+    for(int p = 0; p < NUM_ROLLOUT_POLICIES && in_pool_worker; p++){
+        job->stats[p].rollouts += after[p].rollouts - before[p].rollouts;
+        job->stats[p].steps += after[p].steps - before[p].steps;
+        job->stats[p].ns += after[p].ns - before[p].ns;
+    }
+    for(int p = 0; p < NUM_PERF_PHASES && count_perf; p++){
+        for(int c = 0; c < NUM_PERF_COUNTERS; c++){job->perf.counts[PERF_PHASE_ROLLOUTS][c] += perf.counts[p][c];}
+    }
+    pthread_mutex_unlock(&pool_lock);
+}
+
+static void* pool_worker(void* arg){
+    in_pool_worker = 1;
+    uint64_t seen = 0;
+    pthread_mutex_lock(&pool_lock);
+    while(true){
+        while(!stopping && (current_job == NULL || generation == seen)){
+            pthread_cond_wait(&work_cond, &pool_lock);
+        }
+        if(stopping){break;}
+        seen = generation;
+        RolloutJob* job = current_job;
+        job->workers++;
+        pthread_mutex_unlock(&pool_lock);
+        play_chunks(job);
+        pthread_mutex_lock(&pool_lock);
+        if(--job->workers == 0){pthread_cond_signal(&done_cond);}
+    }
+    pthread_mutex_unlock(&pool_lock);
+    return NULL;
+}
+
+void rollout_pool_shutdown(){
+    // stops the workers, later calls play their rollouts on the calling thread
+    pthread_mutex_lock(&submit_lock);
+    pthread_mutex_lock(&pool_lock);
+    stopping = 1;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&pool_lock);
+    for(int t = 0; t < num_workers; t++){
+        pthread_join(workers[t], NULL);
+    }
+    free(workers);
+    workers = NULL;
+    num_workers = 0;
+    stopping = 0;
+    pthread_mutex_unlock(&submit_lock);
+}
+
+int rollout_pool_init(int num_threads){
+    /*num_threads: threads playing the rollouts of a call, the caller included, 0 for one per core,
+     1 to play them on the calling thread only
+     replaces the workers of an earlier call
+     returns the number of threads, 1 if no worker could be started
+    */
+    rollout_pool_shutdown();
+    if(num_threads <= 0){num_threads = sysconf(_SC_NPROCESSORS_ONLN);}
+    if(num_threads <= 1){return 1;}
+    pthread_mutex_lock(&submit_lock);
+    workers = malloc((num_threads - 1) * sizeof(pthread_t));
+    if(workers != NULL){
+        for(int t = 0; t < num_threads - 1; t++){
+            if(pthread_create(&workers[num_workers], NULL, pool_worker, NULL) == 0){num_workers++;}
+        }
+    }
+    pthread_mutex_unlock(&submit_lock);
+    return num_workers + 1;
+}
+
+void run_rollouts(Board* board, const int* moves, const int* trials, int num_arms, int default_policy, double* params, long long* sums){
+    /*plays trials[a] rollouts after moves[a] for each of num_arms (at most 4) arms, as run_rollout
+     sums[a] is set to the sum of their final scores
+    */
+    for(int a = 0; a < num_arms; a++){sums[a] = 0;}
+    int total = 0;
+    for(int a = 0; a < num_arms; a++){total += trials[a];}
+    if(num_arms > MAX_ARMS || total == 0){return;}
+
+    if(num_workers == 0 || in_pool_worker || pthread_mutex_trylock(&submit_lock) != 0){
+        for(int a = 0; a < num_arms; a++){
+            for(int t = 0; t < trials[a]; t++){
+                sums[a] += run_rollout(board, moves[a], default_policy, params);
+            }
+        }
+        return;
+    }
+
+    RolloutJob job = {0};
+    job.board = *board;
+    job.moves = moves;
+    job.trials = trials;
+    job.num_arms = num_arms;
+    job.policy = default_policy;
+    job.params = params;
+    job.abort = search_abort;
+    job.seed = ((uint64_t)rollout_rand() << 31) ^ rollout_rand();
+    job.count_perf = perf_counting();
+    // about 4 chunks per thread, so threads that draw long games are not left to finish alone
+    job.chunk_size = total / (4 * (num_workers + 1));
+    job.chunk_size = (job.chunk_size < 1) ? 1 : job.chunk_size;
+    for(int a = 0; a < num_arms; a++){
+        job.chunk_starts[a + 1] = job.chunk_starts[a] + (trials[a] + job.chunk_size - 1) / job.chunk_size;
+    }
+
+    pthread_mutex_lock(&pool_lock);
+    current_job = &job;
+    generation++;
+    pthread_cond_broadcast(&work_cond);
+    pthread_mutex_unlock(&pool_lock);
+
+    play_chunks(&job);
+
+    // no worker can join once the job is withdrawn, wait for the ones still playing
+    pthread_mutex_lock(&pool_lock);
+    current_job = NULL;
+    while(job.workers > 0){
+        pthread_cond_wait(&done_cond, &pool_lock);
+    }
+    pthread_mutex_unlock(&pool_lock);
+    pthread_mutex_unlock(&submit_lock);
+
+    for(int a = 0; a < num_arms; a++){sums[a] = job.sums[a];}
+    add_rollout_stats(job.stats);
+    perf_add(&job.perf);
+}
@@ -0,0 +1,285 @@
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <pthread.h>
+#include <string.h>
+#include "twency48.h"
+
+// CPython binding
+// twency48_native.search(engine, board, params, score, power_rep=False) is engine_move called straight from Python,
+// without building ctypes arrays and decoding the move on every call. Boards and params are read
+// through the buffer protocol (bytes, numpy arrays, array.array, memoryviews) in place, lists are
+// converted in C, and the GIL is released for the whole search, so Python threads playing their own
+// games search in parallel. Engines that share state between calls (the tt engines) take a lock
+// instead, one search at a time. The result is a SearchResult: the move, the value the engine gave
+// each move at the root and the counters of search_stats.
+// The module is linked against twency48.so rather than its own copy of the engine, so the
+// transposition table, opening book and rollout pool set up through ctypes are the ones it uses.
+// Built by `make -f twency48/build/makefile pymodule`, next to twency48.so.
+
+#define MIN_PARAMS 8    // params shorter than this are copied and padded with zeros, engines read up to [6]
+#define MAX_PARAMS 64
+
+static pthread_mutex_t stateful_lock = PTHREAD_MUTEX_INITIALIZER;
+static PyTypeObject SearchResultType;
+
+static PyStructSequence_Field result_fields[] = {
+    {"move", "Move played, RIGHT, LEFT, UP or DOWN"},
+    {"values", "value of each Move at the root, nan for invalid moves, 0 for moves the engine did not score"},
+    {"nodes", "nodes visited"},
+    {"depth", "depth searched from the root"},
+    {"tt_hits", "nodes answered by the transposition table"},
+    {"cutoffs", "decision nodes left unsearched by a probability cutoff"},
+    {"arm_rollouts", "rollouts played after each Move by the Monte Carlo engines"},
+    {"search_us", "time taken by the search"},
+    {NULL, NULL},
+};
+
+static PyStructSequence_Desc result_desc = {
+    "twency48_native.SearchResult",
+    "move chosen by an engine and the stats of its search",
+    result_fields,
+    8,
+};
+
+static int format_code(const char* format){
+    // the struct code of a buffer of native or little endian scalars, 0 if it is something else
+    if(format == NULL){return 'B';}
+    if(*format == '@' || *format == '=' || *format == '<'){format++;}
+    return (format[0] && !format[1]) ? format[0] : 0;
+}
+
+static bool read_int(const char* p, int code, long long* value){
+    switch(code){
+        case 'b': *value = *(const signed char*)p; return 1;
+        case 'B': case 'c': *value = *(const unsigned char*)p; return 1;
+        case 'h': *value = *(const short*)p; return 1;
+        case 'H': *value = *(const unsigned short*)p; return 1;
+        case 'i': *value = *(const int*)p; return 1;
+        case 'I': *value = *(const unsigned int*)p; return 1;
+        case 'l': *value = *(const long*)p; return 1;
+        case 'L': *value = *(const unsigned long*)p; return 1;
+        case 'q': *value = *(const long long*)p; return 1;
+        case 'Q': *value = *(const unsigned long long*)p; return 1;
+        case 'n': *value = *(const Py_ssize_t*)p; return 1;
+        case 'N': *value = *(const size_t*)p; return 1;
+        default: return 0;
+    }
+}
+
+static bool store_tile(Board* board, int i, long long value, bool power_rep){
+    if(power_rep){
+        if(value < 0 || value > 17){return 0;}
+        board->tiles[i] = value;
+        return 1;
+    }
+    // int rep, 0 or a power of two from 2 to 131072
+    if(value == 0){
+        board->tiles[i] = 0;
+        return 1;
+    }
+    if(value < 2 || value > (1 << 17) || (value & (value - 1))){return 0;}
+    board->tiles[i] = __builtin_ctzll(value);
+    return 1;
+}
+
+static bool read_board(PyObject* obj, bool power_rep, Board* board){
+    /*board: a packed board (int), or a buffer or sequence of 16 integer tiles, in int rep as get_tiles
+     unless power_rep, whatever the itemsize, so a uint8 array of tile values is not taken for powers
+     raises and returns 0 if it is none of those
+    */
+    if(PyLong_Check(obj)){
+        uint64_t packed = PyLong_AsUnsignedLongLong(obj);
+        if(packed == (uint64_t)-1 && PyErr_Occurred()){return 0;}
+        unpack_board(packed, board);
+        return 1;
+    }
+    if(PyObject_CheckBuffer(obj)){
+        Py_buffer view;
+        if(PyObject_GetBuffer(obj, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0){return 0;}
+        int code = format_code(view.format);
+        bool ok = view.itemsize > 0 && view.len / view.itemsize == 16;
+        for(int i = 0; i < 16 && ok; i++){
+            long long value;
+            ok = read_int((const char*)view.buf + i * view.itemsize, code, &value) && store_tile(board, i, value, power_rep);
+        }
+        PyBuffer_Release(&view);
+        if(!ok){PyErr_SetString(PyExc_ValueError, power_rep ? "board must hold 16 integer tiles in power rep" : "board must hold 16 integer tiles in int rep");}
+        return ok;
+    }
+    PyObject* seq = PySequence_Fast(obj, "board must be a packed board, a buffer or a sequence of 16 tiles");
+    if(seq == NULL){return 0;}
+    bool ok = PySequence_Fast_GET_SIZE(seq) == 16;
+    for(int i = 0; i < 16 && ok; i++){
+        long long value = PyLong_AsLongLong(PySequence_Fast_GET_ITEM(seq, i));
+        ok = !(value == -1 && PyErr_Occurred()) && store_tile(board, i, value, power_rep);
+    }
+    Py_DECREF(seq);
+    if(!ok && !PyErr_Occurred()){PyErr_SetString(PyExc_ValueError, power_rep ? "board must hold 16 tiles in power rep" : "board must hold 16 tiles in int rep");}
+    return ok;
+}
+
+static double* read_params(PyObject* obj, Py_buffer* view, double* copy){
+    /*params: a contiguous buffer of doubles, used in place (view is left held for the caller to release)
+     when it has at least MIN_PARAMS, or a buffer or sequence of numbers copied into copy and padded
+     returns NULL and raises if it is neither
+    */
+    view->obj = NULL;
+    memset(copy, 0, MAX_PARAMS * sizeof(double));
+    if(PyObject_CheckBuffer(obj)){
+        if(PyObject_GetBuffer(obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) != 0){return NULL;}
+        Py_ssize_t n = view->len / sizeof(double);
+        if(format_code(view->format) != 'd' || n < 1 || n > MAX_PARAMS){
+            PyBuffer_Release(view);
+            view->obj = NULL;
+            PyErr_SetString(PyExc_ValueError, "params must be a buffer of 1 to 64 doubles");
+            return NULL;
+        }
+        if(n >= MIN_PARAMS){return (double*)view->buf;}
+        memcpy(copy, view->buf, n * sizeof(double));
+        PyBuffer_Release(view);
+        view->obj = NULL;
+        return copy;
+    }
+    PyObject* seq = PySequence_Fast(obj, "params must be a buffer of doubles or a sequence of numbers");
+    if(seq == NULL){return NULL;}
+    Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    if(n < 1 || n > MAX_PARAMS){
+        Py_DECREF(seq);
+        PyErr_SetString(PyExc_ValueError, "params must have 1 to 64 numbers");
+        return NULL;
+    }
+    for(Py_ssize_t i = 0; i < n; i++){
+        copy[i] = PyFloat_AsDouble(PySequence_Fast_GET_ITEM(seq, i));
+        if(copy[i] == -1.0 && PyErr_Occurred()){
+            Py_DECREF(seq);
+            return NULL;
+        }
+    }
+    Py_DECREF(seq);
+    return copy;
+}
+
+static int read_engine(PyObject* obj){
+    // an Engine id or name, -1 and raises if there is no such engine
+    int engine = -1;
+    if(PyUnicode_Check(obj)){
+        const char* name = PyUnicode_AsUTF8(obj);
+        if(name == NULL){return -1;}
+        engine = engine_by_name(name);
+    }else{
+        engine = PyLong_AsLong(obj);
+        if(engine == -1 && PyErr_Occurred()){return -1;}
+    }
+    if(engine < 0 || engine_function(engine) == NULL){
+        PyErr_SetString(PyExc_ValueError, "unknown engine");
+        return -1;
+    }
+    return engine;
+}
+
+static PyObject* tuple4_double(const double* values){
+    return Py_BuildValue("(dddd)", values[0], values[1], values[2], values[3]);
+}
+
+static PyObject* native_search(PyObject* self, PyObject* args, PyObject* kwargs){
+    (void)self;
+    static char* keywords[] = {"engine", "board", "params", "score", "power_rep", NULL};
+    PyObject *engine_obj, *board_obj, *params_obj;
+    int score = 0;
+    int power_rep = 0;
+    if(!PyArg_ParseTupleAndKeywords(args, kwargs, "OOO|i$p", keywords, &engine_obj, &board_obj, &params_obj, &score, &power_rep)){return NULL;}
+    int engine = read_engine(engine_obj);
+    if(engine < 0){return NULL;}
+    Board board;
+    if(!read_board(board_obj, power_rep, &board)){return NULL;}
+    board.score = score;
+    Py_buffer view;
+    double copy[MAX_PARAMS];
+    double* params = read_params(params_obj, &view, copy);
+    if(params == NULL){return NULL;}
+
+    int valid_moves[4];
+    int k = get_valid_moves(&board, valid_moves);
+    bool stateful = !engine_is_threadsafe(engine);
+    SearchStats stats;
+    struct timespec start, end;
+    int move;
+    Py_BEGIN_ALLOW_THREADS
+    if(stateful){pthread_mutex_lock(&stateful_lock);}
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    move = engine_move(engine, &board, params);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    get_search_stats(&stats);
+    if(stateful){pthread_mutex_unlock(&stateful_lock);}
+    Py_END_ALLOW_THREADS
+    if(view.obj != NULL){PyBuffer_Release(&view);}
+
+    double values[4] = {NAN, NAN, NAN, NAN};
+    for(int i = 0; i < k; i++){values[valid_moves[i]] = stats.move_values[valid_moves[i]];}
+
+    PyObject* result = PyStructSequence_New(&SearchResultType);
+    if(result == NULL){return NULL;}
+    PyObject* items[8] = {
+        PyLong_FromLong(move),
+        tuple4_double(values),
+        PyLong_FromLongLong(stats.nodes),
+        PyLong_FromLong(stats.depth),
+        PyLong_FromLongLong(stats.tt_hits),
+        PyLong_FromLongLong(stats.cutoffs),
+        Py_BuildValue("(LLLL)", stats.arm_rollouts[0], stats.arm_rollouts[1], stats.arm_rollouts[2], stats.arm_rollouts[3]),
+        PyFloat_FromDouble((end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) * 1e-3),
+    };
+    for(int i = 0; i < 8; i++){
+        if(items[i] == NULL){
+            for(int j = i + 1; j < 8; j++){Py_XDECREF(items[j]);}
+            Py_DECREF(result);
+            return NULL;
+        }
+        PyStructSequence_SET_ITEM(result, i, items[i]);
+    }
+    return result;
+}
+
+static PyMethodDef native_methods[] = {
+    {"search", (PyCFunction)(void(*)(void))native_search, METH_VARARGS | METH_KEYWORDS,
+     "search(engine, board, params, score=0, *, power_rep=False) -> SearchResult\n"
+     "asks engine (an id or name from ENGINES) for its move on board, as engine_move\n"
+     "board: a packed board (int), or a buffer (bytes, numpy, array) or sequence of 16 integer tiles,\n"
+     "       in int rep as Board.get_tiles, or in power rep (0 for empty, 1 for 2, ...) with power_rep=True\n"
+     "params: a buffer of doubles, used in place, or a sequence of numbers\n"
+     "the GIL is released while the engine searches"},
+    {NULL, NULL, 0, NULL},
+};
+
+static struct PyModuleDef native_module = {
+    PyModuleDef_HEAD_INIT,
+    "twency48_native",
+    "CPython binding of the twency48 engines, see twency48/src/pymodule.c",
+    -1,
+    native_methods,
+    NULL, NULL, NULL, NULL,
+};
+
+PyMODINIT_FUNC PyInit_twency48_native(void){
+    if(SearchResultType.tp_name == NULL && PyStructSequence_InitType2(&SearchResultType, &result_desc) != 0){return NULL;}
+    PyObject* module = PyModule_Create(&native_module);
+    if(module == NULL){return NULL;}
+    Py_INCREF(&SearchResultType);
+    PyModule_AddObject(module, "SearchResult", (PyObject*)&SearchResultType);
+    PyModule_AddIntConstant(module, "RIGHT", RIGHT);
+    PyModule_AddIntConstant(module, "LEFT", LEFT);
+    PyModule_AddIntConstant(module, "UP", UP);
+    PyModule_AddIntConstant(module, "DOWN", DOWN);
+    PyObject* engines = PyDict_New();
+    for(int e = 0; e < NUM_ENGINES && engines != NULL; e++){
+        PyObject* id = PyLong_FromLong(e);
+        if(id != NULL){PyDict_SetItemString(engines, engine_name(e), id);}
+        Py_XDECREF(id);
+    }
+    if(engines == NULL || PyModule_AddObject(module, "ENGINES", engines) != 0){
+        Py_XDECREF(engines);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -0,0 +1,176 @@
+#include <pthread.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "twency48.h"
+
+// Bulk re-evaluation
+// Re-searches every recorded position of a trace with a (possibly changed) evaluator, and writes how
+// the new search rates each move next to the move that was recorded.
+// Positions are handed to worker threads a chunk at a time. The output file holds one ReevalRecord
+// per trace record at a fixed offset and each chunk is written once complete, so an interrupted run
+// continues from the chunks that are not marked done.
+
+#define REEVAL_MAGIC "T48REEVL"
+#define REEVAL_VERSION 1
+
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t item_size;
+    uint64_t num_records;
+    int32_t search;         // 0: expectiminmax, 1: expectiminmax1
+    int32_t reserved;
+    double params[5];       // params the run was started with, a resumed run must match them
+} ReevalFileHeader;
+
+typedef struct{
+    const TraceRecord* records;
+    uint64_t num_records;
+    int fd;
+    SearchFn search;
+    double params[5];
+    int chunk_size;
+    uint64_t next_chunk;    // shared counter, taken with __atomic_fetch_add
+} ReevalJob;
+
+static void reeval_position(const TraceRecord* record, SearchFn search, double* params, ReevalRecord* out){
+    if(record->flags & TRACE_UNPACKABLE){
+        // the board was not recorded, the position is marked done without a move
+        *out = (ReevalRecord){.values = {-INFINITY, -INFINITY, -INFINITY, -INFINITY}, .best_move = -1,
+                              .recorded_move = record->move, .done = 1};
+        return;
+    }
+    Board b;
+    unpack_board(record->board, &b);
+    b.score = record->score;
+    double move_scores[4];
+    int best = search_root(&b, params, search, move_scores);
+
+    out->board = record->board;
+    for(int i = 0; i < 4; i++){
+        out->values[i] = move_scores[i];
+    }
+    out->best_move = best;
+    out->recorded_move = record->move;
+    out->agree = (best == record->move);
+    out->delta = (record->move >= 0 && record->move < 4) ? move_scores[best] - move_scores[(int)record->move] : 0;
+    out->done = 1;
+}
+
+static void* reeval_worker(void* arg){
+    ReevalJob* job = arg;
+    ReevalRecord* chunk = malloc(job->chunk_size * sizeof(ReevalRecord));
+    uint64_t num_chunks = (job->num_records + job->chunk_size - 1) / job->chunk_size;
+
+    while(true){
+        uint64_t c = __atomic_fetch_add(&job->next_chunk, 1, __ATOMIC_RELAXED);
+        if(c >= num_chunks){break;}
+        uint64_t first = c * job->chunk_size;
+        uint64_t count = (first + job->chunk_size <= job->num_records) ? job->chunk_size : job->num_records - first;
+        off_t offset = sizeof(ReevalFileHeader) + first * sizeof(ReevalRecord);
+
+        // positions finished by an earlier run are kept
+        if(pread(job->fd, chunk, count * sizeof(ReevalRecord), offset) != (ssize_t)(count * sizeof(ReevalRecord))){
+            memset(chunk, 0, count * sizeof(ReevalRecord));
+        }
+        uint64_t done = 0;
+        for(uint64_t i = 0; i < count; i++){
+            if(!chunk[i].done){
+                reeval_position(&job->records[first + i], job->search, job->params, &chunk[i]);
+                done++;
+            }
+        }
+        if(done && pwrite(job->fd, chunk, count * sizeof(ReevalRecord), offset) != (ssize_t)(count * sizeof(ReevalRecord))){
+            perror("reeval: write");
+        }
+    }
+    free(chunk);
+    return NULL;
+}
+
+static int open_output(const char* path, ReevalFileHeader* expected){
+    // opens or creates the output file, returns -1 if it belongs to a different run
+    int fd = open(path, O_RDWR | O_CREAT, 0644);
+    if(fd < 0){return -1;}
+    ReevalFileHeader header;
+    ssize_t n = pread(fd, &header, sizeof(header), 0);
+    if(n == 0){
+        size_t size = sizeof(header) + expected->num_records * sizeof(ReevalRecord);
+        if(pwrite(fd, expected, sizeof(*expected), 0) != sizeof(*expected) || ftruncate(fd, size) != 0){
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    if(n != sizeof(header) || memcmp(&header, expected, sizeof(header)) != 0){
+        fprintf(stderr, "reeval: %s was written by a different run\n", path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int reevaluate_trace(const char* trace_path, const char* out_path, int search, double* params, int num_threads, int chunk_size, ReevalSummary* summary){
+    /*re-searches every position of the trace at trace_path and writes a ReevalRecord for each to out_path
+        search: 0 to search with expectiminmax (get_next_move), 1 for expectiminmax1 (get_next_move1)
+        params: as for get_next_move / get_next_move1, [0] is the depth to search
+        num_threads: worker threads, 0 for one per core
+        chunk_size: positions per work item, 0 for a default
+     if out_path exists from an interrupted run with the same trace and params, only positions it does
+     not have are searched
+     summary, if not NULL, is filled in over the whole output
+     returns the number of positions, -1 on error
+    */
+    uint64_t num_records;
+    const TraceRecord* records = trace_map(trace_path, &num_records);
+    if(records == NULL){return -1;}
+
+    ReevalFileHeader header = {REEVAL_MAGIC, REEVAL_VERSION, sizeof(ReevalRecord), num_records, search, 0, {0}};
+    memcpy(header.params, params, ((search == 1) ? 5 : 4) * sizeof(double));
+    int fd = open_output(out_path, &header);
+    if(fd < 0){
+        trace_unmap(records, num_records, sizeof(TraceRecord));
+        return -1;
+    }
+
+    ReevalJob job = {0};
+    job.records = records;
+    job.num_records = num_records;
+    job.fd = fd;
+    job.search = (search == 1) ? expectiminmax1 : expectiminmax;
+    memcpy(job.params, header.params, sizeof(job.params));
+    job.chunk_size = (chunk_size > 0) ? chunk_size : 256;
+
+    if(num_threads <= 0){num_threads = sysconf(_SC_NPROCESSORS_ONLN);}
+    pthread_t threads[num_threads];
+    int started = 0;
+    for(int t = 0; t < num_threads; t++){
+        if(pthread_create(&threads[t], NULL, reeval_worker, &job) == 0){started++;}
+    }
+    if(!started){reeval_worker(&job);}
+    for(int t = 0; t < started; t++){
+        pthread_join(threads[t], NULL);
+    }
+
+    if(summary != NULL){
+        *summary = (ReevalSummary){0};
+        ReevalRecord buffer[1024];
+        for(uint64_t first = 0; first < num_records; first += 1024){
+            uint64_t count = (num_records - first < 1024) ? num_records - first : 1024;
+            if(pread(fd, buffer, count * sizeof(ReevalRecord), sizeof(header) + first * sizeof(ReevalRecord)) != (ssize_t)(count * sizeof(ReevalRecord))){break;}
+            for(uint64_t i = 0; i < count; i++){
+                if(!buffer[i].done || buffer[i].best_move < 0){continue;}
+                summary->positions++;
+                summary->agreements += buffer[i].agree;
+                summary->mean_delta += buffer[i].delta;
+                summary->max_delta = (buffer[i].delta > summary->max_delta) ? buffer[i].delta : summary->max_delta;
+            }
+        }
+        if(summary->positions){summary->mean_delta /= summary->positions;}
+    }
+
+    close(fd);
+    trace_unmap(records, num_records, sizeof(TraceRecord));
+    return num_records;
+}
@@ -0,0 +1,35 @@
+#include "twency48.h"
+
+// command line front end for reevaluate_trace
+
+int main(int argc, char** argv){
+    if(argc < 8){
+        fprintf(stderr,
+            "usage: %s trace out search depth path_penalty loss_penalty score_factor [num_trials] [threads]\n"
+            "  search: 0 for get_next_move, 1 for get_next_move1 (uses num_trials)\n"
+            "  rerun with the same arguments to resume an interrupted run\n", argv[0]);
+        return 2;
+    }
+    int search = atoi(argv[3]);
+    double params[5] = {atof(argv[4]), atof(argv[5]), atof(argv[6]), atof(argv[7]), 0};
+    if(argc > 8){params[4] = atof(argv[8]);}
+    int threads = (argc > 9) ? atoi(argv[9]) : 0;
+
+    ReevalSummary summary;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int n = reevaluate_trace(argv[1], argv[2], search, params, threads, 0, &summary);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if(n < 0){
+        fprintf(stderr, "could not re-evaluate %s into %s\n", argv[1], argv[2]);
+        return 1;
+    }
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("positions: %llu\n", (unsigned long long)summary.positions);
+    printf("agreement: %f\n", summary.positions ? (double)summary.agreements / summary.positions : 0.0);
+    printf("mean delta: %f\n", summary.mean_delta);
+    printf("max delta: %f\n", summary.max_delta);
+    printf("time: %.2fs\n", seconds);
+    return 0;
+}
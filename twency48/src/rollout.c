@@ -0,0 +1,126 @@
+#include "packed.h"
+
+// Rollout policies
+// The Monte Carlo evaluators (estimate_score1, get_MCTS_next_move2/3) play games out to the end with
+// run_rollout. Each caller has its own policy (random moves, or run_EM_trial for get_MCTS_next_move3),
+// set_rollout_policy replaces it for all of them. Rollouts are counted and timed per policy on each
+// thread, see get_rollout_stats.
+
+static int rollout_policy = ROLLOUT_DEFAULT;
+static double rollout_params[4] = {3, 10.282501707392333, 0.0, 4.480025944804589}; // ExpectiMax7's
+static __thread RolloutStats rollout_stats[NUM_ROLLOUT_POLICIES];
+__thread long long rollout_steps = 0;
+__thread Rng* rollout_rng = NULL;
+
+void set_rollout_policy(int policy, double* params){
+    /*policy: one of RolloutPolicy, ROLLOUT_DEFAULT to give every caller its own policy back
+     params: weights for the greedy and em policies, laid out as in get_next_move ([1] to [3] are used),
+     NULL keeps the current ones
+     not thread safe, set it before starting searches
+    */
+    rollout_policy = (policy >= 0 && policy < NUM_ROLLOUT_POLICIES) ? policy : ROLLOUT_DEFAULT;
+    if(params != NULL){
+        for(int i = 0; i < 4; i++){rollout_params[i] = params[i];}
+    }
+}
+
+int get_rollout_policy(){
+    return rollout_policy;
+}
+
+void get_rollout_stats(RolloutStats* stats){
+    // copies the counters of the calling thread, stats has NUM_ROLLOUT_POLICIES entries
+    for(int p = 0; p < NUM_ROLLOUT_POLICIES; p++){stats[p] = rollout_stats[p];}
+}
+
+void add_rollout_stats(const RolloutStats* stats){
+    // adds rollouts played for this thread by others (see pool.c), stats has NUM_ROLLOUT_POLICIES entries
+    for(int p = 0; p < NUM_ROLLOUT_POLICIES; p++){
+        rollout_stats[p].rollouts += stats[p].rollouts;
+        rollout_stats[p].steps += stats[p].steps;
+        rollout_stats[p].ns += stats[p].ns;
+        rollout_steps += stats[p].steps;
+    }
+}
+
+void reset_rollout_stats(){
+    for(int p = 0; p < NUM_ROLLOUT_POLICIES; p++){rollout_stats[p] = (RolloutStats){0};}
+}
+
+static uint64_t spawn_packed(uint64_t board){
+    // place_random_tile on a packed board
+    int empty_tiles[16];
+    int len_empty_tiles = 0;
+    for(int i = 0; i < 16; i++){
+        if(((board >> (4*i)) & 0xF) == 0){empty_tiles[len_empty_tiles++] = i;}
+    }
+    int tile = empty_tiles[rollout_rand() % len_empty_tiles];
+    uint64_t tile_value = ((double)rollout_rand()/(double)RAND_MAX > 0.1) ? 1 : 2;
+    return board | (tile_value << (4*tile));
+}
+
+static int run_packed_trial(Board* board, Move move, int policy, double* params){
+    // plays a game out from board with the greedy or corner policy, returns the final score
+    // boards with tiles past 32768 cannot be packed and are played out randomly, as is the rest of the
+    // game once a move merges two 32768s
+    uint64_t b;
+    if(!pack_board(board, &b)){
+        return run_random_trial(board, move);
+    }
+    move_tables_init();
+    if(move_unpackable_packed(b, move)){
+        return run_random_trial(board, move);
+    }
+    int score = board->score;
+    b = apply_move_packed(b, move, &score);
+    while(has_valid_move_packed(b)){
+        int next_move = (policy == ROLLOUT_GREEDY) ? greedy_move_packed(b, params) : corner_move_packed(b);
+        if(move_unpackable_packed(b, next_move)){
+            Board unpacked;
+            unpack_board(b, &unpacked);
+            unpacked.score = score;
+            return run_random_trial(&unpacked, next_move);
+        }
+        b = spawn_packed(apply_move_packed(b, next_move, &score));
+        rollout_steps++;
+    }
+    return score;
+}
+
+int run_rollout(Board* board, Move move, int default_policy, double* params){
+    /*plays a game out from board after move, with the policy set by set_rollout_policy if there is one,
+     default_policy otherwise
+     params are the caller's get_next_move style params, used by the greedy and em policies, NULL for
+     the ones set with set_rollout_policy
+     returns the final score
+    */
+    int policy = (rollout_policy != ROLLOUT_DEFAULT) ? rollout_policy : default_policy;
+    if(params == NULL){params = rollout_params;}
+
+    int phase = perf_phase(PERF_PHASE_ROLLOUTS);
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long long steps = rollout_steps;
+    int score;
+    switch(policy){
+        case ROLLOUT_GREEDY:
+        case ROLLOUT_CORNER:
+            score = run_packed_trial(board, move, policy, params);
+            break;
+        case ROLLOUT_EM:
+            score = run_EM_trial(board, move, params);
+            break;
+        default:
+            policy = ROLLOUT_RANDOM;
+            score = run_random_trial(board, move);
+            break;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    perf_phase(phase);
+
+    RolloutStats* stats = &rollout_stats[policy];
+    stats->rollouts++;
+    stats->steps += rollout_steps - steps;
+    stats->ns += (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+    return score;
+}
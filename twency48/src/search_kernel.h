@@ -0,0 +1,184 @@
+// Expectiminmax kernel, instantiated by kernels.c once per configuration (no include guard on purpose)
+// The including file defines:
+//   KERNEL_SUFFIX   name of the instance, exported as emm_<suffix> (a SearchFn) and get_next_move_<suffix>
+//   KERNEL_REPR     board representation, the prefix of its operations in kernels.c (char_ or packed_)
+//   KERNEL_EVAL     KERNEL_EVAL_HEURISTIC (estimate_score) or KERNEL_EVAL_ROLLOUT (estimate_score1)
+//   KERNEL_PRUNE    1 to stop searching below decision nodes less likely than params[4]
+//   KERNEL_SAMPLE   1 to search a sample of the empty tiles at chance nodes with many of them
+// Everything the kernel calls is static inline, so each instance is compiled with its evaluator and
+// board operations inlined and the unused branches removed.
+
+#define KCAT(a, b) a##b
+#define KNAME(a, b) KCAT(a, b)
+#define KOP(op) KNAME(KERNEL_REPR, op)
+#define KBOARD KOP(t)
+#define KFN(name) KNAME(name, KERNEL_SUFFIX)
+
+static inline double KFN(kernel_leaf_)(KBOARD b, int score, const KernelParams* kp){
+#if KERNEL_EVAL == KERNEL_EVAL_HEURISTIC
+    return KOP(heuristic)(b, score, kp);
+#else
+    Board board;
+    KOP(to_board)(b, score, &board);
+    return estimate_score1(&board, kp->raw);
+#endif
+}
+
+static double KFN(kernel_node_)(KBOARD b, int score, bool choose_move, int depth, double prob, const KernelParams* kp);
+
+#if KERNEL_SAMPLE
+static double KFN(kernel_sampled_)(KBOARD b, int score, int depth, double prob, int* empty_tiles, int empty_len, const KernelParams* kp){
+    /*chance node over a stratified sample of the empty tiles
+     empty_tiles is split into sample_cells runs of (almost) equal length and one tile is drawn from
+     each, weighted by the length of its run, so the expected value is that of the full chance node
+     the Rng is seeded from the board, so a position always gets the same sample
+    */
+    Rng rng = {kp->sample_seed ^ KOP(key)(b) ^ ((uint64_t)depth << 59)};
+    int k = kp->sample_cells;
+    double values[16];
+    double result = 0;
+    for(int h = 0; h < k; h++){
+        int start = h * empty_len / k;
+        int length = (h+1) * empty_len / k - start;
+        int cell = empty_tiles[start + rng_next(&rng) % length];
+        double weight = (double)length / empty_len;
+        values[h] = 0.9 * KFN(kernel_node_)(KOP(spawn)(b, cell, 1), score, true, depth-1, prob * 0.9 * weight, kp)
+                  + 0.1 * KFN(kernel_node_)(KOP(spawn)(b, cell, 2), score, true, depth-1, prob * 0.1 * weight, kp);
+        result += weight * values[h];
+    }
+
+    // variance of a simple random sample of k tiles, an overestimate for the stratified one
+    double mean = 0, ss = 0;
+    for(int h = 0; h < k; h++){mean += values[h] / k;}
+    for(int h = 0; h < k; h++){ss += (values[h] - mean) * (values[h] - mean);}
+    double variance = (1.0 - (double)k / empty_len) * ss / (k - 1) / k;
+    search_stats.sampled_nodes++;
+    search_stats.sample_variance += prob * prob * variance;
+    return result;
+}
+#endif
+
+HOT_CLONES static double KFN(kernel_node_)(KBOARD b, int score, bool choose_move, int depth, double prob, const KernelParams* kp){
+    // same values as expectiminmax, prob is the probability of reaching this node from the root
+    if((search_abort && *search_abort) || !KOP(exact)()){return 0;}
+    search_stats.nodes++;
+
+    bool leaf = depth == 0;
+#if KERNEL_PRUNE
+    if(!leaf && choose_move && prob < kp->prob_cutoff){
+        leaf = true;
+        search_stats.cutoffs++;
+    }
+#endif
+    if(leaf || !KOP(has_moves)(b)){
+        return KFN(kernel_leaf_)(b, score, kp);
+    }
+
+    double result;
+    if(choose_move){
+        result = kp->loss_penalty;
+        for(int i = 0; i < 4; i++){
+            KBOARD child;
+            int gained = 0;
+            if(KOP(move)(b, kernel_moves[i], &child, &gained)){
+                double value = KFN(kernel_node_)(child, score + gained, false, depth-1, prob, kp);
+                result = (result > value) ? result : value;
+            }
+        }
+    }else{
+        result = 0;
+        int empty_tiles[16];
+        int empty_len = KOP(empties)(b, empty_tiles);
+#if KERNEL_SAMPLE
+        if(empty_len > kp->sample_above && empty_len > kp->sample_cells){
+            return KFN(kernel_sampled_)(b, score, depth, prob, empty_tiles, empty_len, kp);
+        }
+#endif
+        for(int i = 0; i < empty_len; i++){
+            result += 0.9/empty_len * KFN(kernel_node_)(KOP(spawn)(b, empty_tiles[i], 1), score, true, depth-1, prob * 0.9/empty_len, kp);
+            result += 0.1/empty_len * KFN(kernel_node_)(KOP(spawn)(b, empty_tiles[i], 2), score, true, depth-1, prob * 0.1/empty_len, kp);
+        }
+    }
+    return result;
+}
+
+double KFN(emm_)(Board* board, double* params, bool choose_move, int depth){
+    // SearchFn for this kernel, usable anywhere expectiminmax is
+    KernelParams kp;
+    kernel_params(params, &kp, KERNEL_PRUNE, KERNEL_SAMPLE);
+    KBOARD b;
+    if(!KOP(from_board)(board, &b)){
+        return expectiminmax(board, params, choose_move, depth);
+    }
+    bool outer = KOP(begin_exact)();
+    double value = KFN(kernel_node_)(b, board->score, choose_move, depth, 1.0, &kp);
+    if(!KOP(end_exact)(outer)){
+        return expectiminmax(board, params, choose_move, depth);
+    }
+    return value;
+}
+
+int KFN(get_next_move_)(int* tiles, int score, double* params){
+    /*takes in the set of tiles (in int rep form), the current score, and a set of parameters
+        [0]: depth
+        [1]: path_penalty
+        [2]: loss_penalty
+        [3]: score_factor
+        [4]: probability cutoff for pruned kernels, num_trials for rollout kernels, empty tiles
+             above which chance nodes are sampled for sampled kernels
+        [5]: tiles searched at a sampled chance node (sampled kernels)
+        [6]: seed of the samples (sampled kernels)
+     returns the best move from this state
+    */
+    search_stats = (SearchStats){0};
+    search_stats.depth = params[0];
+    char powertiles[16];
+    intrep_to_powerrep(powertiles, tiles);
+    Board board;
+    memcpy(board.tiles, powertiles, 16);
+    board.score = score;
+
+    KernelParams kp;
+    kernel_params(params, &kp, KERNEL_PRUNE, KERNEL_SAMPLE);
+    KBOARD b;
+    if(!KOP(from_board)(&board, &b)){
+        return get_next_move(tiles, score, params);
+    }
+
+    event_emit(EVENT_SEARCH_BEGIN, params[0], 0, 0);
+    bool outer = KOP(begin_exact)();
+    double max_score = -1000000000;
+    int max_move = UP;
+    bool any = false;
+    for(int i = 0; i < 4; i++){
+        KBOARD child;
+        int gained = 0;
+        if(KOP(move)(b, kernel_moves[i], &child, &gained)){
+            if(!any){max_move = kernel_moves[i]; any = true;}
+            double value = KFN(kernel_node_)(child, score + gained, false, params[0]-1, 1.0, &kp);
+            if(max_score < value){
+                max_score = value;
+                max_move = kernel_moves[i];
+            }
+            search_stats.move_values[kernel_moves[i]] = value;
+            event_emit(EVENT_ROOT_MOVE, kernel_moves[i], value, 0);
+        }
+    }
+    if(!KOP(end_exact)(outer)){
+        event_emit(EVENT_SEARCH_END, max_move, search_stats.nodes, search_stats.cutoffs);
+        return get_next_move(tiles, score, params);
+    }
+    event_emit(EVENT_SEARCH_END, max_move, search_stats.nodes, search_stats.cutoffs);
+    return max_move;
+}
+
+#undef KCAT
+#undef KNAME
+#undef KOP
+#undef KBOARD
+#undef KFN
+#undef KERNEL_SUFFIX
+#undef KERNEL_REPR
+#undef KERNEL_EVAL
+#undef KERNEL_PRUNE
+#undef KERNEL_SAMPLE
@@ -0,0 +1,384 @@
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "packed.h"
+
+// Move server
+// One warm process answering move requests from any number of local clients over a Unix socket, so
+// the tables, the transposition table and the page cache are built once instead of once per tool.
+// The io thread reads fixed size requests (MoveRequest) from every connection and queues them; a
+// pool of workers takes them off the queue in batches, so a burst from many clients costs few
+// wakeups and identical requests in a batch (same engine, board and params) are searched once. A
+// worker takes no more than its share of the queue (split over the idle workers), plus any copies of
+// a request it already holds, so a burst is spread over every core. Each answer is a MoveResponse,
+// written by the worker that searched it. Requests carry an optional latency budget: when the queue
+// already holds more work than the budget allows, the request is refused at once (SERVER_BUSY)
+// instead of being answered late. The work is estimated from the recent search times of the same
+// engine with a similar params[0] (depth, trials or iterations). See MoveServer.py.
+
+#define SERVER_REQUEST_MAGIC 0x51383454 // "T48Q"
+#define SERVER_RESPONSE_MAGIC 0x52383454 // "T48R"
+#define SERVER_MAX_PARAMS 8
+#define SERVER_MAX_CLIENTS 256
+#define SERVER_QUEUE_SIZE 4096
+#define SERVER_BATCH 16
+#define SERVER_SERVICE_BUCKETS 32 // params[0] 0-15 exactly, then one bucket per doubling
+
+typedef enum{
+    SERVER_OK = 0,
+    SERVER_BUSY = 1,        // refused by admission control, nothing was searched
+    SERVER_BAD_REQUEST = 2, // unknown or stateful engine, bad tiles or params
+} ServerStatus;
+
+typedef struct{
+    uint32_t magic;
+    uint32_t id;            // echoed in the response, requests on a connection may be answered out of order
+    int32_t engine;         // Engine, the tt engines share state between calls and are refused
+    int32_t score;
+    uint8_t tiles[16];      // power rep
+    uint32_t budget_us;     // latency budget, 0 for none
+    int32_t num_params;
+    double params[SERVER_MAX_PARAMS];
+} MoveRequest; // 104 bytes
+
+typedef struct{
+    uint32_t magic;
+    uint32_t id;
+    int32_t move;           // Move, -1 unless status is SERVER_OK
+    int32_t status;         // ServerStatus
+    uint64_t nodes;
+    float search_us;
+    float queue_us;         // time between the request being read and a worker taking it
+} MoveResponse; // 32 bytes
+
+typedef struct{
+    int fd;
+    int refs;               // the io thread's plus one per queued request, freed at 0
+    pthread_mutex_t write_lock;
+    uint8_t buffer[sizeof(MoveRequest)];
+    size_t buffered;
+} Client;
+
+typedef struct{
+    Client* client;
+    MoveRequest request;
+    double arrival_us;
+    double estimate_us;     // expected search time, counted in queue.work_us until answered
+} Pending;
+
+static struct{
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    Pending items[SERVER_QUEUE_SIZE];
+    int head;
+    int count;
+    int active;                         // workers holding a batch
+    double work_us;                     // estimated search time of the queued and unanswered requests
+    double service_us[NUM_ENGINES][SERVER_SERVICE_BUCKETS]; // moving average of the search time per request
+    int num_workers;
+} queue = {PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+static volatile sig_atomic_t stopping = 0;
+
+static double now_us(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1e6 + now.tv_nsec * 1e-3;
+}
+
+static void release_client(Client* client){
+    if(__atomic_sub_fetch(&client->refs, 1, __ATOMIC_ACQ_REL) == 0){
+        close(client->fd);
+        pthread_mutex_destroy(&client->write_lock);
+        free(client);
+    }
+}
+
+static void respond(Client* client, MoveResponse* response){
+    // a client that went away is not an error, its answers are dropped
+    pthread_mutex_lock(&client->write_lock);
+    size_t sent = 0;
+    while(sent < sizeof(*response)){
+        ssize_t n = send(client->fd, (char*)response + sent, sizeof(*response) - sent, MSG_NOSIGNAL);
+        if(n <= 0){
+            if(n < 0 && errno == EINTR){continue;}
+            break;
+        }
+        sent += n;
+    }
+    pthread_mutex_unlock(&client->write_lock);
+}
+
+static void refuse(Client* client, MoveRequest* request, int status){
+    MoveResponse response = {SERVER_RESPONSE_MAGIC, request->id, -1, status, 0, 0, 0};
+    respond(client, &response);
+}
+
+static double* service_estimate(MoveRequest* request){
+    // the moving average kept for requests like request, call with queue.lock held
+    double p0 = request->params[0];
+    int bucket = 0;
+    if(p0 >= SERVER_SERVICE_BUCKETS / 2){
+        bucket = SERVER_SERVICE_BUCKETS / 2 + (int)log2(p0 / (SERVER_SERVICE_BUCKETS / 2));
+        bucket = (bucket < SERVER_SERVICE_BUCKETS) ? bucket : SERVER_SERVICE_BUCKETS - 1;
+    }else if(p0 > 0){
+        bucket = p0;
+    }
+    return &queue.service_us[request->engine][bucket];
+}
+
+static bool valid_request(MoveRequest* request){
+    if(request->magic != SERVER_REQUEST_MAGIC || engine_function(request->engine) == NULL){return 0;}
+    if(!engine_is_threadsafe(request->engine)){return 0;}
+    if(request->num_params < 1 || request->num_params > SERVER_MAX_PARAMS){return 0;}
+    for(int i = 0; i < 16; i++){
+        if(request->tiles[i] > 17){return 0;}
+    }
+    return 1;
+}
+
+static void admit(Client* client, MoveRequest* request){
+    /*queues request, or refuses it if it is malformed, the queue is full, or the estimated wait
+     (the work ahead of it spread over the workers) plus its own search would exceed its budget
+     the estimates are 0 until a similar request has been searched, so the first ones are admitted
+    */
+    if(!valid_request(request)){
+        refuse(client, request, SERVER_BAD_REQUEST);
+        return;
+    }
+    pthread_mutex_lock(&queue.lock);
+    double service = *service_estimate(request);
+    double wait = queue.work_us / queue.num_workers;
+    if(queue.count == SERVER_QUEUE_SIZE || (request->budget_us && wait + service > request->budget_us)){
+        pthread_mutex_unlock(&queue.lock);
+        refuse(client, request, SERVER_BUSY);
+        return;
+    }
+    __atomic_add_fetch(&client->refs, 1, __ATOMIC_ACQ_REL);
+    Pending* pending = &queue.items[(queue.head + queue.count) % SERVER_QUEUE_SIZE];
+    pending->client = client;
+    pending->request = *request;
+    pending->arrival_us = now_us();
+    pending->estimate_us = service;
+    queue.work_us += service;
+    queue.count++;
+    pthread_cond_signal(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+}
+
+static bool same_search(MoveRequest* a, MoveRequest* b){
+    return a->engine == b->engine && a->score == b->score && a->num_params == b->num_params
+        && memcmp(a->tiles, b->tiles, 16) == 0 && memcmp(a->params, b->params, a->num_params * sizeof(double)) == 0;
+}
+
+static void* server_worker(void* arg){
+    (void)arg;
+    Pending batch[SERVER_BATCH];
+    MoveResponse responses[SERVER_BATCH];
+    while(true){
+        pthread_mutex_lock(&queue.lock);
+        while(queue.count == 0 && !stopping){
+            pthread_cond_wait(&queue.ready, &queue.lock);
+        }
+        if(stopping){
+            pthread_mutex_unlock(&queue.lock);
+            return NULL;
+        }
+        // this worker's share of the queue, then the copies of those requests waiting right behind them
+        int idle = queue.num_workers - queue.active;
+        int share = (queue.count + idle - 1) / idle;
+        int n = 0;
+        while(n < SERVER_BATCH && queue.count > 0){
+            MoveRequest* next = &queue.items[queue.head].request;
+            if(n >= share){
+                bool copy = false;
+                for(int j = 0; j < n && !copy; j++){copy = same_search(next, &batch[j].request);}
+                if(!copy){break;}
+            }
+            batch[n++] = queue.items[queue.head];
+            queue.head = (queue.head + 1) % SERVER_QUEUE_SIZE;
+            queue.count--;
+        }
+        queue.active++;
+        if(queue.count > 0){pthread_cond_signal(&queue.ready);} // the rest is for another worker
+        pthread_mutex_unlock(&queue.lock);
+
+        double taken = now_us();
+        for(int i = 0; i < n; i++){
+            MoveRequest* request = &batch[i].request;
+            MoveResponse* response = &responses[i];
+            int same = -1;
+            for(int j = 0; j < i && same < 0; j++){
+                if(same_search(request, &batch[j].request)){same = j;}
+            }
+            if(same >= 0){
+                *response = responses[same];
+            }else{
+                Board board;
+                for(int t = 0; t < 16; t++){board.tiles[t] = request->tiles[t];}
+                board.score = request->score;
+                double params[SERVER_MAX_PARAMS] = {0};
+                memcpy(params, request->params, request->num_params * sizeof(double));
+
+                search_stats = (SearchStats){0};
+                double start = now_us();
+                int move = engine_move(request->engine, &board, params);
+                double search_us = now_us() - start;
+                *response = (MoveResponse){SERVER_RESPONSE_MAGIC, 0, move, SERVER_OK, search_stats.nodes, search_us, 0};
+            }
+            pthread_mutex_lock(&queue.lock);
+            if(same < 0){
+                double* service = service_estimate(request);
+                *service = (*service == 0) ? response->search_us : 0.9 * *service + 0.1 * response->search_us;
+            }
+            queue.work_us -= batch[i].estimate_us;
+            pthread_mutex_unlock(&queue.lock);
+            response->id = request->id;
+            response->queue_us = taken - batch[i].arrival_us;
+            respond(batch[i].client, response);
+            release_client(batch[i].client);
+        }
+
+        pthread_mutex_lock(&queue.lock);
+        queue.active--;
+        if(queue.count == 0 && queue.active == 0){queue.work_us = 0;} // keeps rounding from building up
+        pthread_mutex_unlock(&queue.lock);
+    }
+}
+
+static int listen_on(const char* path){
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(fd < 0){return -1;}
+    struct sockaddr_un address = {0};
+    address.sun_family = AF_UNIX;
+    if(strlen(path) >= sizeof(address.sun_path)){close(fd); return -1;}
+    strcpy(address.sun_path, path);
+    unlink(path);
+    if(bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, 64) != 0){
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool read_requests(Client* client){
+    // reads what the client has sent, admitting every complete request, returns 0 once it has gone
+    ssize_t n = recv(client->fd, client->buffer + client->buffered, sizeof(MoveRequest) - client->buffered, 0);
+    if(n < 0 && (errno == EINTR || errno == EAGAIN)){return 1;}
+    if(n <= 0){return 0;}
+    client->buffered += n;
+    if(client->buffered == sizeof(MoveRequest)){
+        MoveRequest request;
+        memcpy(&request, client->buffer, sizeof(request));
+        client->buffered = 0;
+        admit(client, &request);
+    }
+    return 1;
+}
+
+static void stop(int signal){
+    (void)signal;
+    stopping = 1;
+}
+
+int main(int argc, char** argv){
+    const char* path = "/tmp/twency48.sock";
+    int num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    int tt_log2 = TT_DEFAULT_LOG2_ENTRIES;
+    const char* shared = NULL;
+    int opt;
+    while((opt = getopt(argc, argv, "s:w:T:S:")) != -1){
+        switch(opt){
+            case 's': path = optarg; break;
+            case 'w': num_workers = atoi(optarg); break;
+            case 'T': tt_log2 = atoi(optarg); break;
+            case 'S': shared = optarg; break;
+            default:
+                fprintf(stderr,
+                    "usage: %s [-s socket] [-w workers] [-T tt_log2_entries] [-S shm_prefix]\n"
+                    "  -S shares the move tables and transposition table with other processes through\n"
+                    "     the shared memory segments <shm_prefix>_tables and <shm_prefix>_tt (eg. -S /twency48)\n", argv[0]);
+                return 2;
+        }
+    }
+    if(num_workers < 1){num_workers = 1;}
+
+    // warm everything up front so the first requests are not slower than the rest
+    if(shared != NULL){
+        char name[256];
+        snprintf(name, sizeof(name), "%s_tables", shared);
+        if(!move_tables_attach_shared(name)){fprintf(stderr, "could not attach %s, using private tables\n", name);}
+        snprintf(name, sizeof(name), "%s_tt", shared);
+        if(!tt_attach_shared(name, tt_log2)){
+            fprintf(stderr, "could not attach %s, using a private table\n", name);
+            tt_resize(tt_log2);
+        }
+    }else{
+        tt_resize(tt_log2);
+    }
+    move_tables_init();
+
+    int listen_fd = listen_on(path);
+    if(listen_fd < 0){
+        fprintf(stderr, "could not listen on %s\n", path);
+        return 1;
+    }
+    struct sigaction action = {0};
+    action.sa_handler = stop;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    queue.num_workers = num_workers;
+    pthread_t workers[num_workers];
+    for(int w = 0; w < num_workers; w++){
+        pthread_create(&workers[w], NULL, server_worker, NULL);
+    }
+    fprintf(stderr, "serving on %s with %d workers\n", path, num_workers);
+
+    struct pollfd fds[SERVER_MAX_CLIENTS + 1];
+    Client* clients[SERVER_MAX_CLIENTS + 1];
+    int num_fds = 1;
+    fds[0] = (struct pollfd){listen_fd, POLLIN, 0};
+    while(!stopping){
+        if(poll(fds, num_fds, 200) <= 0){continue;}
+        for(int i = num_fds - 1; i >= 1; i--){
+            if(!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))){continue;}
+            if(!read_requests(clients[i])){
+                // queued requests still hold the client, it is freed after their answers
+                shutdown(clients[i]->fd, SHUT_RD);
+                release_client(clients[i]);
+                fds[i] = fds[num_fds - 1];
+                clients[i] = clients[num_fds - 1];
+                num_fds--;
+            }
+        }
+        if(fds[0].revents & POLLIN){
+            int fd = accept(listen_fd, NULL, NULL);
+            if(fd >= 0 && num_fds <= SERVER_MAX_CLIENTS){
+                Client* client = calloc(1, sizeof(Client));
+                client->fd = fd;
+                client->refs = 1;
+                pthread_mutex_init(&client->write_lock, NULL);
+                clients[num_fds] = client;
+                fds[num_fds++] = (struct pollfd){fd, POLLIN, 0};
+            }else if(fd >= 0){
+                close(fd);
+            }
+        }
+    }
+
+    pthread_mutex_lock(&queue.lock);
+    pthread_cond_broadcast(&queue.ready);
+    pthread_mutex_unlock(&queue.lock);
+    for(int w = 0; w < num_workers; w++){
+        pthread_join(workers[w], NULL);
+    }
+    close(listen_fd);
+    unlink(path);
+    return 0;
+}
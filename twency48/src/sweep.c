@@ -0,0 +1,146 @@
+#include <pthread.h>
+#include <string.h>
+#include "twency48.h"
+
+// Parameter sweeps with common random numbers
+// Every parameter set plays the same games: game g of every set uses spawn seed seed+g, so the sets
+// are compared on identical spawn sequences and the per game score differences have far less
+// variance than the scores themselves. play_game also seeds the engine's own random numbers from the
+// game seed, so the Monte Carlo engines share their rollouts too; only uct searching on several
+// threads (params[4] > 1) stays nondeterministic. (set, game) jobs are shared between threads, results
+// are written as each game finishes and paired statistics against set 0 are computed at the end.
+
+typedef struct{
+    int engine;
+    double* params;
+    int num_params;
+    uint64_t seed;
+    int num_sets;
+    int num_games;
+    GameResult* results;    // num_sets * num_games, set major
+    int next_job;           // shared counter, taken with __atomic_fetch_add
+    FILE* out;
+    pthread_mutex_t out_lock;
+} SweepJob;
+
+static void* sweep_worker(void* arg){
+    SweepJob* job = arg;
+    int num_jobs = job->num_sets * job->num_games;
+    while(true){
+        int j = __atomic_fetch_add(&job->next_job, 1, __ATOMIC_RELAXED);
+        if(j >= num_jobs){break;}
+        // game major order, so every set has played the first games before any set plays the later ones
+        int set = j % job->num_sets;
+        int game = j / job->num_sets;
+
+        // padded with zeros, engines read up to params[6]
+        double params[(job->num_params > 8) ? job->num_params : 8];
+        memset(params, 0, sizeof(params));
+        memcpy(params, job->params + set * job->num_params, job->num_params * sizeof(double));
+        GameResult result = play_game(job->engine, params, job->seed + game, NULL);
+        job->results[set * job->num_games + game] = result;
+
+        if(job->out != NULL){
+            pthread_mutex_lock(&job->out_lock);
+            fprintf(job->out, "%d,%d,%llu,%d,%d,%d\n", set, game, (unsigned long long)(job->seed + game), result.score, result.max_tile, result.turns);
+            fflush(job->out);
+            pthread_mutex_unlock(&job->out_lock);
+        }
+    }
+    return NULL;
+}
+
+static void paired_stats(double* diffs, int n, double* mean, double* ci){
+    // mean and 95% confidence interval half width of paired differences
+    double sum = 0, sum_sq = 0;
+    for(int i = 0; i < n; i++){
+        sum += diffs[i];
+    }
+    *mean = sum / n;
+    for(int i = 0; i < n; i++){
+        sum_sq += (diffs[i] - *mean) * (diffs[i] - *mean);
+    }
+    *ci = (n > 1) ? 1.96 * sqrt(sum_sq / (n - 1) / n) : INFINITY;
+}
+
+void sweep_stats(const GameResult* results, int num_sets, int num_games, SweepStats* stats){
+    /*stats of num_sets sets of num_games results on common spawn sequences, as run_sweep
+        results: num_sets * num_games, set major
+        stats: num_sets entries, the paired differences are against set 0
+    */
+    double* diffs = malloc(num_games * sizeof(double));
+    for(int s = 0; s < num_sets; s++){
+        const GameResult* set_results = results + s * num_games;
+        const GameResult* base = results;
+        SweepStats* st = &stats[s];
+        *st = (SweepStats){0};
+        st->games = num_games;
+        for(int g = 0; g < num_games; g++){
+            st->mean_score += set_results[g].score;
+            st->p2048 += set_results[g].max_tile >= 2048;
+            st->p4096 += set_results[g].max_tile >= 4096;
+            st->p8192 += set_results[g].max_tile >= 8192;
+        }
+        st->mean_score /= num_games;
+        st->p2048 /= num_games;
+        st->p4096 /= num_games;
+        st->p8192 /= num_games;
+
+        for(int g = 0; g < num_games; g++){
+            diffs[g] = set_results[g].score - base[g].score;
+        }
+        paired_stats(diffs, num_games, &st->score_diff, &st->score_diff_ci);
+        for(int g = 0; g < num_games; g++){
+            diffs[g] = (set_results[g].max_tile >= 2048) - (base[g].max_tile >= 2048);
+        }
+        paired_stats(diffs, num_games, &st->p2048_diff, &st->p2048_diff_ci);
+    }
+    free(diffs);
+}
+
+int run_sweep(int engine, double* params, int num_sets, int num_params, uint64_t seed, int num_games, int num_threads, const char* results_path, SweepStats* stats){
+    /*plays num_games games with each of num_sets parameter sets on common spawn sequences
+        params: num_sets rows of num_params parameters for engine
+        seed: game g of every set uses spawns seeded with seed+g
+        num_threads: worker threads, 0 for one per core. engines that share state between calls
+                     (the tt engines) are always run on one thread
+        results_path: if not NULL, a line "set,game,seed,score,max_tile,turns" is appended as each game ends
+        stats: num_sets entries, the paired differences are against set 0
+     returns 0, -1 if engine is not valid or results_path could not be opened
+    */
+    if(engine_function(engine) == NULL || num_sets < 1 || num_games < 1){return -1;}
+
+    SweepJob job = {0};
+    job.engine = engine;
+    job.params = params;
+    job.num_params = num_params;
+    job.seed = seed;
+    job.num_sets = num_sets;
+    job.num_games = num_games;
+    job.results = calloc((size_t)num_sets * num_games, sizeof(GameResult));
+    if(job.results == NULL){return -1;}
+    if(results_path != NULL){
+        job.out = fopen(results_path, "a");
+        if(job.out == NULL){free(job.results); return -1;}
+    }
+    pthread_mutex_init(&job.out_lock, NULL);
+
+    if(num_threads <= 0){num_threads = sysconf(_SC_NPROCESSORS_ONLN);}
+    if(!engine_is_threadsafe(engine)){num_threads = 1;}
+    pthread_t threads[num_threads];
+    int started = 0;
+    for(int t = 0; t < num_threads; t++){
+        if(pthread_create(&threads[t], NULL, sweep_worker, &job) == 0){started++;}
+    }
+    if(!started){sweep_worker(&job);}
+    for(int t = 0; t < started; t++){
+        pthread_join(threads[t], NULL);
+    }
+
+    sweep_stats(job.results, num_sets, num_games, stats);
+
+    if(job.out != NULL){fclose(job.out);}
+    pthread_mutex_destroy(&job.out_lock);
+    free(job.results);
+    return 0;
+}
@@ -0,0 +1,181 @@
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "twency48.h"
+
+// Game traces
+// A trace is a pair of append-only files:
+//   <path>      TraceFileHeader then one TraceRecord per turn, games one after another
+//   <path>.idx  TraceFileHeader then one TraceIndexEntry per finished game
+// Both are flat arrays of fixed size structs, so they can be memory mapped (trace_map) or
+// loaded into numpy with a structured dtype (see Trace.py) without parsing.
+// Records are buffered and written a batch at a time. When a game ends its records are flushed before
+// its index entry is written, so an index entry never points past the end of the records file.
+
+#define TRACE_MAGIC "T48TRACE"
+#define TRACE_VERSION 1
+#define TRACE_BUFFER_RECORDS 4096
+
+typedef struct{
+    char magic[8];
+    uint32_t version;
+    uint32_t item_size;     // sizeof(TraceRecord) or sizeof(TraceIndexEntry)
+} TraceFileHeader;
+
+struct TraceWriter{
+    FILE* records;
+    FILE* index;
+    TraceRecord buffer[TRACE_BUFFER_RECORDS];
+    int buffered;
+    uint64_t num_records;   // records in the file, including buffered ones
+    uint32_t num_games;
+    TraceIndexEntry game;   // game in progress
+};
+
+static FILE* open_appendable(const char* path, uint32_t item_size, uint64_t* count){
+    // opens path for appending, writing the header if the file is new
+    // an existing file must have a valid header for item_size, a partial item at its end is dropped
+    // count is set to the number of items already in the file
+    FILE* file = fopen(path, "a+b");
+    if(file == NULL){return NULL;}
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    if(size == 0){
+        TraceFileHeader header = {TRACE_MAGIC, TRACE_VERSION, item_size};
+        if(fwrite(&header, sizeof(header), 1, file) != 1){fclose(file); return NULL;}
+        *count = 0;
+        return file;
+    }
+
+    TraceFileHeader header;
+    rewind(file);
+    if(size < (long)sizeof(TraceFileHeader) || fread(&header, sizeof(header), 1, file) != 1
+       || memcmp(header.magic, TRACE_MAGIC, 8) != 0 || header.version != TRACE_VERSION || header.item_size != item_size){
+        fclose(file);
+        return NULL;
+    }
+    if((size - sizeof(TraceFileHeader)) % item_size != 0){
+        // drop a partial item left by an interrupted write
+        size -= (size - sizeof(TraceFileHeader)) % item_size;
+        if(ftruncate(fileno(file), size) != 0){fclose(file); return NULL;}
+    }
+    *count = (size - sizeof(TraceFileHeader)) / item_size;
+    return file;
+}
+
+TraceWriter* trace_open(const char* path){
+    // opens a trace for appending games, returns NULL on failure
+    TraceWriter* trace = calloc(1, sizeof(TraceWriter));
+    if(trace == NULL){return NULL;}
+
+    char index_path[4096];
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    uint64_t num_games;
+    trace->records = open_appendable(path, sizeof(TraceRecord), &trace->num_records);
+    trace->index = open_appendable(index_path, sizeof(TraceIndexEntry), &num_games);
+    if(trace->records == NULL || trace->index == NULL){
+        if(trace->records != NULL){fclose(trace->records);}
+        if(trace->index != NULL){fclose(trace->index);}
+        free(trace);
+        return NULL;
+    }
+    trace->num_games = num_games;
+    return trace;
+}
+
+void trace_flush(TraceWriter* trace){
+    fwrite(trace->buffer, sizeof(TraceRecord), trace->buffered, trace->records);
+    trace->buffered = 0;
+    fflush(trace->records);
+    fflush(trace->index);
+}
+
+void trace_begin_game(TraceWriter* trace, uint64_t seed){
+    trace->game = (TraceIndexEntry){0};
+    trace->game.first_record = trace->num_records;
+    trace->game.game = trace->num_games;
+    trace->game.seed = seed;
+}
+
+void trace_record(TraceWriter* trace, Board* board, int move, int score_delta, int spawn_cell, int spawn_value, SearchStats* stats, double search_us){
+    // adds a turn to the game in progress, board is the board the move was chosen on
+    // stats may be NULL if the engine does not report them
+    TraceRecord* record = &trace->buffer[trace->buffered++];
+    // a board with a tile past 32768 cannot be packed, it is recorded as 0 and flagged
+    uint64_t packed = 0;
+    bool packable = pack_board(board, &packed);
+    record->board = packable ? packed : 0;
+    record->score = board->score;
+    record->score_delta = score_delta;
+    record->move = move;
+    record->spawn_cell = spawn_cell;
+    record->spawn_value = spawn_value;
+    record->flags = ((stats != NULL) ? TRACE_HAS_STATS : 0) | (packable ? 0 : TRACE_UNPACKABLE);
+    record->nodes = (stats != NULL) ? (uint32_t)stats->nodes : 0;
+    record->search_us = (stats != NULL) ? search_us : 0;
+    record->game = trace->game.game;
+
+    trace->num_records++;
+    trace->game.num_records++;
+    if(trace->buffered == TRACE_BUFFER_RECORDS){
+        fwrite(trace->buffer, sizeof(TraceRecord), trace->buffered, trace->records);
+        trace->buffered = 0;
+    }
+}
+
+void trace_end_game(TraceWriter* trace, Board* final_board){
+    trace->game.score = final_board->score;
+    trace->game.max_tile = max_tile(final_board);
+    trace_flush(trace);
+    fwrite(&trace->game, sizeof(TraceIndexEntry), 1, trace->index);
+    fflush(trace->index);
+    trace->num_games++;
+}
+
+void trace_close(TraceWriter* trace){
+    if(trace == NULL){return;}
+    trace_flush(trace);
+    fclose(trace->records);
+    fclose(trace->index);
+    free(trace);
+}
+
+static const void* map_items(const char* path, uint32_t item_size, uint64_t* count){
+    // maps the items of a trace or index file read only, returns NULL if the file is not valid
+    *count = 0;
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){return NULL;}
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(TraceFileHeader)){close(fd); return NULL;}
+
+    char* mapped = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){return NULL;}
+
+    TraceFileHeader* header = (TraceFileHeader*)mapped;
+    if(memcmp(header->magic, TRACE_MAGIC, 8) != 0 || header->version != TRACE_VERSION || header->item_size != item_size){
+        munmap(mapped, st.st_size);
+        return NULL;
+    }
+    *count = (st.st_size - sizeof(TraceFileHeader)) / item_size;
+    return mapped + sizeof(TraceFileHeader);
+}
+
+const TraceRecord* trace_map(const char* path, uint64_t* num_records){
+    // maps every record of a trace, release with trace_unmap(records, num_records, sizeof(TraceRecord))
+    return map_items(path, sizeof(TraceRecord), num_records);
+}
+
+const TraceIndexEntry* trace_map_index(const char* path, uint64_t* num_games){
+    // maps the game index of the trace at path (not the .idx path)
+    // release with trace_unmap(index, num_games, sizeof(TraceIndexEntry))
+    char index_path[4096];
+    snprintf(index_path, sizeof(index_path), "%s.idx", path);
+    return map_items(index_path, sizeof(TraceIndexEntry), num_games);
+}
+
+void trace_unmap(const void* mapped, uint64_t count, size_t item_size){
+    if(mapped == NULL){return;}
+    munmap((char*)mapped - sizeof(TraceFileHeader), sizeof(TraceFileHeader) + count * item_size);
+}
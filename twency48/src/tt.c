@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "twency48.h"
+
+// Transposition table
+// Maps a packed board, its score and the kind of node (a decision node, or the chance node of the
+// board just after a move) to the value of that node at a given remaining depth. The score is part
+// of the key: values clamped to the loss penalty deeper in the tree do not scale with the score, so
+// no score-relative value is exact. Values are kept whole, so a value read back is the value searched,
+// and moves chosen from the table are the ones the search would choose, ties included.
+// Keys are salted with the heuristic parameters, so searches with different parameters can share
+// one table without reading each other's values.
+// Each entry is three words, check = key ^ value ^ data, value and data, so a torn or racing write is detected
+// on probe instead of returning a value for the wrong board. This is what lets several processes
+// update a shared table (tt_attach_shared) without locks.
+
+typedef struct{
+    uint64_t check;
+    uint64_t value; // the bits of the double
+    uint64_t data;  // [15:8] depth, [7:0] generation, 0 for an empty entry (stored depths are at least 1)
+} TTEntry;
+
+#define TT_SHARED_MAGIC 0x3834797a6e657774ULL // "twency48"
+
+const int tt_default_log2_entries = TT_DEFAULT_LOG2_ENTRIES; // for ctypes
+
+typedef struct{
+    // start of a shared memory table, the entries follow
+    uint64_t magic;
+    uint64_t log2_entries;
+    uint64_t generation;
+    uint64_t reserved[5];
+} TTSharedHeader;
+
+static TTEntry* tt_table = NULL;
+static uint64_t tt_mask = 0;
+static uint8_t tt_generation = 0;
+static uint64_t tt_salt = 0;
+
+static TTSharedHeader* tt_shared = NULL; // set when the table lives in a shared memory segment
+static size_t tt_shared_size = 0;
+
+static uint64_t mix64(uint64_t key){
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ULL;
+    key ^= key >> 33;
+    return key;
+}
+
+static void tt_release(){
+    if(tt_shared != NULL){
+        munmap(tt_shared, tt_shared_size);
+        tt_shared = NULL;
+    }
+    else{
+        free(tt_table);
+    }
+    tt_table = NULL;
+}
+
+int tt_resize(int log2_entries){
+    // allocates a private table with 2^log2_entries entries, discarding the old one
+    // returns 1 on success
+    TTEntry* table = calloc((size_t)1 << log2_entries, sizeof(TTEntry));
+    if(table == NULL){return 0;}
+    tt_release();
+    tt_table = table;
+    tt_mask = ((uint64_t)1 << log2_entries) - 1;
+    return 1;
+}
+
+int tt_attach_shared(const char* name, int log2_entries){
+    /*places the table in the POSIX shared memory segment name (eg. "/twency48_tt"), creating it if needed
+     every process attached to the same name reads and writes the same entries
+     if the segment already exists its size is used and log2_entries is ignored
+     returns 1 on success, the private table is kept on failure
+    */
+    int fd = shm_open(name, O_RDWR | O_CREAT, 0600);
+    if(fd < 0){return 0;}
+
+    size_t size = sizeof(TTSharedHeader) + ((size_t)1 << log2_entries) * sizeof(TTEntry);
+    struct stat st;
+    if(fstat(fd, &st) != 0){close(fd); return 0;}
+    if(st.st_size == 0){
+        // new segment, ftruncate fills it with zeros which is an empty table
+        if(ftruncate(fd, size) != 0){close(fd); return 0;}
+    }
+    else{
+        size = st.st_size;
+    }
+
+    TTSharedHeader* header = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(header == MAP_FAILED){return 0;}
+
+    // the first process to attach writes the header, the others wait until it is visible
+    // once log2_entries is set the rest of the header is an empty table, so if the creator died
+    // before writing the magic the waiting process writes it instead
+    uint64_t expected = 0;
+    if(__atomic_compare_exchange_n(&header->log2_entries, &expected, (uint64_t)log2_entries, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        __atomic_store_n(&header->magic, TT_SHARED_MAGIC, __ATOMIC_RELEASE);
+    }
+    for(int wait = 0; __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != TT_SHARED_MAGIC; wait++){
+        if(wait == SHARED_WAIT_POLLS){
+            uint64_t zero = 0;
+            __atomic_compare_exchange_n(&header->magic, &zero, TT_SHARED_MAGIC, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+            break;
+        }
+        usleep(100);
+    }
+    if(__atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) != TT_SHARED_MAGIC){
+        // something else lives in the segment
+        munmap(header, size);
+        return 0;
+    }
+    uint64_t shared_log2 = __atomic_load_n(&header->log2_entries, __ATOMIC_ACQUIRE);
+    if(sizeof(TTSharedHeader) + ((size_t)1 << shared_log2) * sizeof(TTEntry) > size){
+        munmap(header, size);
+        return 0;
+    }
+
+    tt_release();
+    tt_shared = header;
+    tt_shared_size = size;
+    tt_table = (TTEntry*)(header + 1);
+    tt_mask = ((uint64_t)1 << shared_log2) - 1;
+    return 1;
+}
+
+void tt_unlink_shared(const char* name){
+    // removes the shared segment name, processes still attached keep their mapping
+    shm_unlink(name);
+}
+
+void tt_clear(){
+    if(tt_table != NULL){
+        memset(tt_table, 0, (tt_mask + 1) * sizeof(TTEntry));
+    }
+}
+
+void tt_new_search(double* params){
+    // starts a new search, entries from older searches are kept but may be replaced
+    // values depend on params[1:4], which salt the keys
+    if(tt_table == NULL){tt_resize(TT_DEFAULT_LOG2_ENTRIES);}
+    uint64_t salt = 0;
+    for(int i = 1; i < 4; i++){
+        uint64_t bits;
+        memcpy(&bits, &params[i], sizeof(double));
+        salt = mix64(salt ^ bits);
+    }
+    tt_salt = salt;
+    if(tt_shared != NULL){
+        tt_generation = __atomic_add_fetch(&tt_shared->generation, 1, __ATOMIC_RELAXED);
+    }
+    else{
+        tt_generation++;
+    }
+}
+
+static uint64_t tt_key(uint64_t board, int score, bool chance){
+    return board ^ tt_salt ^ mix64(((uint64_t)chance << 32 | (uint32_t)score) + 1);
+}
+
+bool tt_probe(uint64_t key, int score, bool chance, int depth, double* value){
+    // returns 1 and sets value if the node of the board (key) with score was searched to at least depth
+    if(tt_table == NULL){return 0;}
+    key = tt_key(key, score, chance);
+    TTEntry* entry = &tt_table[mix64(key) & tt_mask];
+    uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    uint64_t bits = __atomic_load_n(&entry->value, __ATOMIC_RELAXED);
+    uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+    if((check ^ bits ^ data) != key || data == 0){return 0;}
+    if((int)((data >> 8) & 0xFF) < depth){return 0;}
+
+    memcpy(value, &bits, sizeof(double));
+    return 1;
+}
+
+void tt_store(uint64_t key, int score, bool chance, int depth, double value){
+    // replaces the entry if it is from an older search or was searched less deep
+    if(tt_table == NULL){return;}
+    key = tt_key(key, score, chance);
+    TTEntry* entry = &tt_table[mix64(key) & tt_mask];
+    uint64_t old = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    if(old != 0 && (old & 0xFF) == tt_generation && (int)((old >> 8) & 0xFF) > depth){return;}
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(double));
+    uint64_t data = ((uint64_t)(depth & 0xFF) << 8) | tt_generation;
+    __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->value, bits, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->check, key ^ bits ^ data, __ATOMIC_RELAXED);
+}
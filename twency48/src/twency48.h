@@ -0,0 +1,490 @@
+#ifndef TWENCY48_H
+#define TWENCY48_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <float.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <math.h>
+#include <stdint.h>
+
+
+typedef struct{
+    // each row is represented by a char, starting in top right corner
+    // each char represents the power of the tile (2^tile_value), unless it is 0 in which case 00000000 = 0 != 2^0
+    // score represents the current score in the game
+
+    char tiles[16];
+    int score;
+} Board;
+
+typedef enum{
+    UP = 2,
+    DOWN = 3,
+    LEFT = 1,
+    RIGHT = 0,
+    NONE = -1
+}Move;
+
+// hardware counters of an engine call, see perf.c
+typedef enum{
+    PERF_CYCLES = 0,
+    PERF_INSTRUCTIONS = 1,
+    PERF_L1D_MISSES = 2,    // L1 data cache read misses
+    PERF_LLC_MISSES = 3,    // last level cache misses
+    PERF_BRANCH_MISSES = 4,
+    PERF_TASK_CLOCK = 5,    // ns on a cpu, a software counter, there when the others are not
+    NUM_PERF_COUNTERS
+} PerfCounter;
+
+typedef enum{
+    PERF_PHASE_SEARCH = 0,      // everything not in another phase, move generation included
+    PERF_PHASE_LEAVES = 1,      // evaluating the leaves under depth 1 chance nodes (chance_node_leaves)
+    PERF_PHASE_ROLLOUTS = 2,    // run_rollout
+    NUM_PERF_PHASES
+} PerfPhase;
+
+typedef enum{
+    PERF_OFF = 0,
+    PERF_CALLS = 1,         // count every engine_move call
+    PERF_PHASES = 2,        // and split the counts by PerfPhase
+} PerfLevel;
+
+typedef struct{
+    uint64_t counts[NUM_PERF_PHASES][NUM_PERF_COUNTERS];   // everything is in PERF_PHASE_SEARCH unless PERF_PHASES
+    uint32_t available;     // bit c set if counter c was counted, 0 if the call was not
+} PerfStats;
+
+typedef struct{
+    // counters for the last search run on a thread, see get_search_stats
+    long long nodes;        // nodes visited
+    long long tt_hits;      // nodes answered by the transposition table
+    long long tt_stores;    // nodes written to the transposition table
+    int depth;              // depth searched from the root
+    long long sampled_nodes;    // chance nodes that only searched a sample of the empty tiles
+    double sample_variance;     // estimated variance of the root value from that sampling
+    long long cutoffs;          // decision nodes left unsearched by a probability cutoff
+    long long arm_rollouts[4];  // rollouts played after each Move by the flat Monte Carlo engines
+    double move_values[4];      // value of each Move at the root (EVENT_ROOT_MOVE, the mean of EVENT_ARM), 0 if not scored
+    PerfStats perf;             // set by engine_move when perf_enable is on
+} SearchStats;
+
+// seedable random numbers (splitmix64), for anything that has to be reproducible or thread safe
+typedef struct{
+    uint64_t state;
+} Rng;
+
+static inline uint64_t rng_next(Rng* rng){
+    uint64_t z = (rng->state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline double rng_double(Rng* rng){
+    // uniform in [0, 1)
+    return (rng_next(rng) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// signature of the get_next_move style entry points, see engine_move
+typedef int (*MoveFn)(int* tiles, int score, double* params);
+
+typedef enum{
+    ENGINE_EXPECTIMAX = 0,      // get_next_move
+    ENGINE_EXPECTIMAX1 = 1,     // get_next_move1
+    ENGINE_EXPECTIMAX_TT = 2,   // get_next_move_tt
+    ENGINE_EXPECTIMAX1_TT = 3,  // get_next_move1_tt
+    ENGINE_MCTS = 4,            // get_MCTS_next_move
+    ENGINE_MCTS1 = 5,           // get_MCTS_next_move1
+    ENGINE_MCTS2 = 6,           // get_MCTS_next_move2
+    ENGINE_MCTS3 = 7,           // get_MCTS_next_move3
+    ENGINE_PACKED = 8,          // get_next_move_packed
+    ENGINE_PACKED_PRUNED = 9,   // get_next_move_packed_pruned
+    ENGINE_PACKED_ROLLOUT = 10, // get_next_move_packed_rollout
+    ENGINE_PACKED_SAMPLED = 11, // get_next_move_packed_sampled
+    ENGINE_UCT = 12,            // get_next_move_uct
+    ENGINE_MCTS_HALVING = 13,   // get_MCTS_next_move_halving
+    NUM_ENGINES
+} Engine;
+
+typedef struct{
+    int score;
+    int max_tile;   // int rep
+    int turns;
+} GameResult;
+
+// a game in progress, everything play_game_from needs to carry on with it, see game.c
+typedef struct{
+    Board board;
+    Rng spawns;
+    Rng rollouts;       // the engine's random numbers (rollout_rand) while the game is played
+    int turns;
+    bool over;          // no valid moves left
+    bool skip_book;     // search every move, even those the open book has
+} GameState;
+
+// called by play_game_from after each move with the board before it, the move, the spawned tile and
+// the time the engine took, returning 0 stops the game there
+typedef bool (*GameHook)(void* context, const GameState* game, const Board* before, int move, int spawn_cell, int spawn_value, double search_us);
+
+// results of one parameter set in a sweep, see sweep.c
+typedef struct{
+    int games;
+    double mean_score;
+    double p2048;           // fraction of games reaching 2048
+    double p4096;
+    double p8192;
+    double score_diff;      // mean paired score difference against set 0
+    double score_diff_ci;   // half width of its 95% confidence interval
+    double p2048_diff;      // paired difference in the 2048 rate against set 0
+    double p2048_diff_ci;
+} SweepStats;
+
+// one turn of a game trace, 32 bytes, see trace.c for the file layout
+typedef struct{
+    uint64_t board;         // packed board before the move, 0 if TRACE_UNPACKABLE
+    int32_t score;          // score before the move
+    int32_t score_delta;    // score gained by the move
+    int8_t move;
+    int8_t spawn_cell;      // cell of the tile placed after the move, -1 if none
+    int8_t spawn_value;     // power rep of the spawned tile
+    uint8_t flags;          // TRACE_HAS_STATS if nodes and search_us are set, TRACE_UNPACKABLE if board is not set
+    uint32_t nodes;         // nodes searched for this move
+    float search_us;        // time taken to choose the move
+    uint32_t game;          // game number within the file
+} TraceRecord;
+
+#define TRACE_HAS_STATS 1
+#define TRACE_UNPACKABLE 2      // the board has a tile past 32768, which pack_board cannot hold
+
+// one game of a trace, entries of the .idx file next to the trace
+typedef struct{
+    uint64_t first_record;  // index of the game's first record in the trace
+    uint32_t num_records;
+    uint32_t game;
+    int32_t score;          // final score
+    int32_t max_tile;       // final max tile, int rep
+    uint64_t seed;          // spawn seed, 0 if the game was not seeded
+} TraceIndexEntry;
+
+typedef struct TraceWriter TraceWriter;
+
+// re-evaluation of one trace record, see reeval.c
+typedef struct{
+    uint64_t board;
+    float values[4];        // score of each move under the new search (indexed by Move), -inf if invalid
+    int8_t best_move;       // best move under the new search, -1 if the record has no board (TRACE_UNPACKABLE)
+    int8_t recorded_move;
+    uint8_t agree;          // 1 if best_move == recorded_move
+    uint8_t done;
+    float delta;            // values[best_move] - values[recorded_move]
+} ReevalRecord;
+
+typedef struct{
+    uint64_t positions;
+    uint64_t agreements;
+    double mean_delta;
+    double max_delta;
+} ReevalSummary;
+
+// one game of a checkpointed evaluation run, 48 bytes, see eval.c for the file layout
+typedef enum{
+    EVAL_PENDING = 0,       // not started
+    EVAL_PLAYING = 1,       // in flight, the fields are its last saved turn
+    EVAL_DONE = 2,
+} EvalStatus;
+
+typedef struct{
+    uint64_t rng;           // state of the spawn Rng
+    uint64_t rollout_rng;   // state of the engine's Rng (rollout_rand)
+    char tiles[16];         // power rep, unpacked so tiles past 32768 are kept
+    int32_t score;
+    int32_t turns;
+    int32_t max_tile;       // int rep, once done
+    int32_t status;         // EvalStatus
+} EvalGame;
+
+// one position of an opening book, 24 bytes, see book.c for the file layout
+typedef struct{
+    uint64_t board;         // packed board
+    double value;           // mean final score of the self-play games that reached it
+    uint32_t count;         // self-play games that reached it
+    int32_t move;           // move the engine chose
+} BookEntry;
+
+// one ply of enumerate_states as columns of count states, see enumerate.c
+typedef struct{
+    uint64_t* boards;       // packed
+    double* probs;          // probability of reaching the state
+    double* scores;         // probability weighted mean score of the paths reaching it
+    uint64_t count;
+    uint64_t capacity;
+    double dropped_mass;    // probability of the states removed by the caps or unpackable (two 32768s merged)
+    int plies;              // plies expanded
+} Frontier;
+
+typedef enum{
+    ENUM_SPAWN = 0,         // a state for every empty cell with a 2 or a 4
+    ENUM_MOVE = 1,          // a state for every move the EnumMovePolicy allows
+} EnumPly;
+
+typedef enum{
+    ENUM_MOVES_ALL = 0,     // every valid move, with equal probability
+    ENUM_MOVES_GREEDY = 1,  // the best move one move ahead, as the greedy rollout policy
+} EnumMovePolicy;
+
+// result of estimate_win_probability, see winprob.c
+typedef struct{
+    double probability;     // wins / rollouts
+    double low;             // Wilson interval of the probability
+    double high;
+    long long rollouts;
+    long long wins;
+    long long steps;        // moves played by all the rollouts
+    int rounds;             // batches played before stopping
+} WinEstimate;
+
+// columns of extract_features, see features.c
+typedef enum{
+    FEATURE_EMPTY = 0,          // empty tiles
+    FEATURE_MAX_TILE = 1,       // largest tile, power rep
+    FEATURE_PATH_PENALTY = 2,   // snake path penalty of estimate_score, before params[1]
+    FEATURE_MONOTONICITY = 3,   // path penalty of every row and column in its better direction
+    FEATURE_MERGES = 4,         // merges of moving left plus merges of moving up
+    FEATURE_MOVES = 5,          // valid moves, bit m for Move m, 0 if the game is lost
+    NUM_FEATURES
+} Feature;
+
+// move choice in the playouts of the Monte Carlo evaluators, see rollout.c
+typedef enum{
+    ROLLOUT_DEFAULT = -1,   // each caller's own policy
+    ROLLOUT_RANDOM = 0,     // uniformly random valid moves (run_random_trial)
+    ROLLOUT_GREEDY = 1,     // best estimate_score one move ahead
+    ROLLOUT_CORNER = 2,     // first valid move of down, right, left, up
+    ROLLOUT_EM = 3,         // depth 3 expectiminmax per move (run_EM_trial)
+    NUM_ROLLOUT_POLICIES
+} RolloutPolicy;
+
+typedef struct{
+    // rollouts played with one policy on a thread, see get_rollout_stats
+    long long rollouts;
+    long long steps;        // moves played in them
+    double ns;              // time spent in them, ns / steps is the cost of a step
+} RolloutStats;
+
+// kinds of EventRecord, see events.c
+typedef enum{
+    EVENT_SEARCH_BEGIN = 1,     // arg: depth
+    EVENT_SEARCH_END = 2,       // arg: move returned, value0: nodes, value1: prob cutoffs
+    EVENT_ROOT_MOVE = 3,        // a root move searched to full depth, arg: move, value0: its score
+    EVENT_ROLLOUTS = 4,         // a batch of rollouts finished, arg: rollouts, value0: mean score, value1: ns taken
+    EVENT_STOP = 5,             // track and stop decision, arg: trials, value0: statistic, value1: 1 if the threshold was met, 0 if out of trials
+    EVENT_ARM = 6,              // an arm when stopping, arg: move, value0: mean, value1: samples
+    EVENT_WIN_CONDITION = 7,    // track_and_stop1's win condition, arg: its 8 entries, 4 bits each
+} EventType;
+
+typedef struct{
+    // one event, 32 bytes, the layout of the file written by events_drain
+    uint64_t ns;            // CLOCK_MONOTONIC
+    uint16_t type;          // EventType
+    uint16_t thread;        // ring the event was recorded in, one per live thread
+    int32_t arg;
+    double value0;
+    double value1;
+} EventRecord;
+
+// signature shared by expectiminmax and expectiminmax1
+typedef double (*SearchFn)(Board* board, double* params, bool choose_move, int depth);
+
+// set per thread to abandon a running search, searches return 0 once *search_abort is nonzero
+extern __thread volatile int* search_abort;
+extern __thread SearchStats search_stats;
+// moves played by rollouts on this thread
+extern __thread long long rollout_steps;
+// random numbers of rollouts on this thread, rand() unless a rollout pool worker or play_game has set its own Rng
+extern __thread Rng* rollout_rng;
+static inline int rollout_rand(){
+    // in [0, RAND_MAX] as rand()
+    return (rollout_rng != NULL) ? (int)(rng_next(rollout_rng) % ((uint64_t)RAND_MAX + 1)) : rand();
+}
+
+// events.c, event_emit records an event if recording is enabled
+extern volatile int events_enabled;
+void event_record(int type, int arg, double value0, double value1);
+static inline void event_emit(int type, int arg, double value0, double value1){
+    if(events_enabled){event_record(type, arg, value0, value1);}
+}
+
+// perf.c, perf_phase attributes the following counts to phase while engine_move is counting phases
+// and returns the phase to go back to
+extern volatile int perf_level;
+extern __thread int perf_phases_on;
+int perf_switch_phase(int phase);
+static inline int perf_phase(int phase){
+    return perf_phases_on ? perf_switch_phase(phase) : phase;
+}
+
+#define TT_DEFAULT_LOG2_ENTRIES 20 // 24MB
+// 1s of 100us polls for the creator of a shared memory segment (tt.c, movetab.c) to finish its header
+#define SHARED_WAIT_POLLS 10000
+
+// the optimized builds (make opt, make pgo) compile the hottest functions once per instruction set,
+// the loader picks the best one the cpu supports
+#ifdef TWENCY48_CLONES
+#define HOT_CLONES __attribute__((target_clones("avx512f", "avx2", "sse4.2", "default")))
+#else
+#define HOT_CLONES
+#endif
+
+// main.c
+double get_rand();
+int apply_move(Board* board, Move move);
+int check_valid_move(Board* board, Move move);
+int get_empty_tiles(Board* board, int* empty_tiles);
+int get_valid_moves(Board* board, int* valid_moves);
+void set_tile(Board* board, int position, char value);
+int get_score(Board* board);
+void copy_board_values(Board* b1, Board* b2);
+bool pack_board(Board* board, uint64_t* packed);
+void unpack_board(uint64_t packed, Board* board);
+void get_search_stats(SearchStats* stats);
+void powerep_to_intrep(char* powerrep, int* intrep);
+void intrep_to_powerrep(char* powerrep, int* intrep);
+double estimate_score(Board* board, double* params);
+double estimate_score1(Board* board, double* params);
+void place_random_tile(Board* board);
+int run_random_trial(Board* board, Move move);
+int run_EM_trial(Board* board, Move move, double* params);
+double expectiminmax(Board* board, double* params, bool choose_move, int depth);
+double expectiminmax1(Board* board, double* params, bool choose_move, int depth);
+double expectiminmax_tt(Board* board, double* params, bool choose_move, int depth);
+double expectiminmax1_tt(Board* board, double* params, bool choose_move, int depth);
+int search_root(Board* board, double* params, SearchFn search, double* move_scores);
+int get_next_move(int* tiles, int score, double* params);
+int get_next_move1(int* tiles, int score, double* params);
+int get_next_move_tt(int* tiles, int score, double* params);
+int get_next_move1_tt(int* tiles, int score, double* params);
+int get_MCTS_next_move(int* tiles, int score, double* params);
+int get_MCTS_next_move1(int* tiles, int score, double* params);
+int get_MCTS_next_move2(int* tiles, int score, double* params);
+int get_MCTS_next_move3(int* tiles, int score, double* params);
+
+// tt.c
+extern const int tt_default_log2_entries;
+int tt_resize(int log2_entries);
+int tt_attach_shared(const char* name, int log2_entries);
+void tt_unlink_shared(const char* name);
+void tt_clear();
+void tt_new_search(double* params);
+bool tt_probe(uint64_t key, int score, bool chance, int depth, double* value);
+void tt_store(uint64_t key, int score, bool chance, int depth, double value);
+
+// kernels.c, one SearchFn and entry point per kernel instance
+double emm_char(Board* board, double* params, bool choose_move, int depth);
+double emm_packed(Board* board, double* params, bool choose_move, int depth);
+double emm_packed_pruned(Board* board, double* params, bool choose_move, int depth);
+double emm_packed_rollout(Board* board, double* params, bool choose_move, int depth);
+double emm_packed_sampled(Board* board, double* params, bool choose_move, int depth);
+int get_next_move_char(int* tiles, int score, double* params);
+int get_next_move_packed(int* tiles, int score, double* params);
+int get_next_move_packed_pruned(int* tiles, int score, double* params);
+int get_next_move_packed_rollout(int* tiles, int score, double* params);
+int get_next_move_packed_sampled(int* tiles, int score, double* params);
+
+// trace.c
+TraceWriter* trace_open(const char* path);
+void trace_begin_game(TraceWriter* trace, uint64_t seed);
+void trace_record(TraceWriter* trace, Board* board, int move, int score_delta, int spawn_cell, int spawn_value, SearchStats* stats, double search_us);
+void trace_end_game(TraceWriter* trace, Board* final_board);
+void trace_flush(TraceWriter* trace);
+void trace_close(TraceWriter* trace);
+const TraceRecord* trace_map(const char* path, uint64_t* num_records);
+const TraceIndexEntry* trace_map_index(const char* path, uint64_t* num_games);
+void trace_unmap(const void* mapped, uint64_t count, size_t item_size);
+
+// game.c
+MoveFn engine_function(int engine);
+const char* engine_name(int engine);
+int engine_by_name(const char* name);
+bool engine_is_threadsafe(int engine);
+int engine_move(int engine, Board* board, double* params);
+int place_random_tile_rng(Board* board, Rng* rng, int* value);
+Rng game_rollout_rng(uint64_t seed);
+int max_tile(Board* board);
+void game_start(GameState* game, uint64_t seed);
+bool play_game_from(GameState* game, int engine, double* params, GameHook hook, void* context);
+GameResult play_game(int engine, double* params, uint64_t seed, TraceWriter* trace);
+int play_games(int engine, double* params, uint64_t seed, int num_games, const char* trace_path, GameResult* results);
+
+// reeval.c
+int reevaluate_trace(const char* trace_path, const char* out_path, int search, double* params, int num_threads, int chunk_size, ReevalSummary* summary);
+
+// sweep.c
+int run_sweep(int engine, double* params, int num_sets, int num_params, uint64_t seed, int num_games, int num_threads, const char* results_path, SweepStats* stats);
+void sweep_stats(const GameResult* results, int num_sets, int num_games, SweepStats* stats);
+
+// rollout.c
+void set_rollout_policy(int policy, double* params);
+int get_rollout_policy();
+void get_rollout_stats(RolloutStats* stats);
+void reset_rollout_stats();
+void add_rollout_stats(const RolloutStats* stats);
+int run_rollout(Board* board, Move move, int default_policy, double* params);
+
+// pool.c
+int rollout_pool_init(int num_threads);
+void rollout_pool_shutdown();
+void run_rollouts(Board* board, const int* moves, const int* trials, int num_arms, int default_policy, double* params, long long* sums);
+
+// events.c
+void events_enable(int enable);
+uint64_t event_clock();
+void event_rollouts(uint64_t start, int rollouts, double total_score);
+long long events_drain(const char* path);
+long long events_dropped();
+
+// book.c
+long long book_open(const char* path);
+void book_close();
+bool book_accepts(int engine, double* params, int num_params);
+int book_move(int engine, int* tiles, int score, double* params, int num_params);
+int book_engine_move(int engine, Board* board, double* params);
+void book_get_stats(long long* lookups, long long* hits);
+long long book_build(const char* path, int engine, double* params, int num_params, uint64_t seed, int num_games, int max_plies, int num_threads, long long* positions);
+
+// enumerate.c
+int enumerate_states(Frontier* frontier, uint64_t board, int score, int first_ply, int num_plies, int move_policy, double* params, uint64_t max_states, double min_prob);
+void frontier_free(Frontier* frontier);
+
+// uct.c
+int get_next_move_uct(int* tiles, int score, double* params);
+
+// eval.c
+int run_evaluation(const char* checkpoint_path, int engine, double* params, int num_params, uint64_t seed, int num_games, int num_threads, double checkpoint_s, const char* results_path, GameResult* results);
+void evaluation_stop();
+
+// halving.c
+int get_MCTS_next_move_halving(int* tiles, int score, double* params);
+
+// winprob.c
+int estimate_win_probability(uint64_t board, int* target, int first_move, int policy, double* params, double ci_width, double z, int batch, long long max_rollouts, int num_threads, uint64_t seed, WinEstimate* result);
+
+// features.c
+int extract_features(const void* boards, uint64_t count, size_t stride, int32_t** columns, int num_threads);
+
+// perf.c
+int perf_enable(int level);
+const char* perf_counter_name(int counter);
+void perf_begin();
+void perf_end(PerfStats* stats);
+bool perf_counting();
+void perf_add(const PerfStats* stats);
+
+// ponder.c
+int get_next_move_ponder(int* tiles, int score, double* params);
+int get_next_move1_ponder(int* tiles, int score, double* params);
+void ponder_stop();
+
+#endif
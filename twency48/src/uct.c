@@ -0,0 +1,340 @@
+#include <pthread.h>
+#include <string.h>
+#include "packed.h"
+
+// Monte Carlo tree search
+// get_next_move_uct grows a tree of decision nodes (a board to move on) and chance nodes (a board
+// waiting for its spawn) instead of sampling the root moves flat like get_MCTS_next_move2, so the
+// rollouts through a position keep informing the moves below it.
+// Nodes live in one arena per calling thread, reused between calls, grown only when a search needs
+// more and freed when the thread exits. They refer to each other by index: a node's children are a
+// list through first_child and next_sibling. Decision nodes choose a chance node child by UCB1;
+// chance nodes draw a spawn from its real distribution and only add a new child for it while the
+// node has fewer than
+// widening_k * visits^widening_alpha children, otherwise the draw is redrawn among the existing ones.
+// With more than one thread the threads share the tree. A visit is counted on the way down and its
+// reward added on the way back up, so nodes other threads are in the middle of look worse until
+// their rollouts finish (virtual loss) and the threads spread over the tree. Every thread draws its
+// spawns and rollouts from its own Rng, seeded from the caller's rollout_rand, so none of them share rand().
+
+#define UCT_MAX_PATH 1024
+#define UCT_NONE UINT32_MAX
+
+typedef enum{
+    UCT_DECISION = 0,
+    UCT_CHANCE = 1,
+} UctKind;
+
+typedef struct{
+    uint64_t board;             // packed, before the move for decision nodes, before the spawn for chance nodes
+    int64_t reward_sum;         // score gained from the root over every finished visit
+    uint32_t visits;            // finished and in flight
+    uint32_t first_child;
+    uint32_t next_sibling;
+    int32_t score;
+    uint8_t kind;               // UctKind
+    uint8_t label;              // move for chance nodes, spawn (cell * 2 + value - 1) for decision nodes
+    uint8_t expanded;           // decision nodes: 1 once their chance children exist
+    uint8_t lock;               // taken while changing the children
+} UctNode;
+
+typedef struct{
+    UctNode* nodes;
+    uint32_t capacity;
+    uint32_t used;              // taken with __atomic_fetch_add
+    int root_score;
+    int iterations;
+    int next_iteration;         // shared counter
+    double exploration;
+    double widening_k;
+    double widening_alpha;
+    int64_t max_reward;         // largest reward seen, rewards are divided by it for UCB
+    int unpackable;             // a move merged two 32768s, set with __atomic_store_n
+} UctTree;
+
+typedef struct{
+    UctTree* tree;
+    uint64_t seed;
+} UctWorker;
+
+static __thread UctNode* arena = NULL;
+static __thread uint32_t arena_capacity = 0;
+static pthread_key_t arena_key;
+static pthread_once_t arena_key_once = PTHREAD_ONCE_INIT;
+
+static void free_arena(void* owned){
+    // thread exit
+    free(owned);
+}
+
+static void make_arena_key(){
+    pthread_key_create(&arena_key, free_arena);
+}
+
+static void lock_node(UctNode* node){
+    while(__atomic_exchange_n(&node->lock, 1, __ATOMIC_ACQUIRE)){}
+}
+
+static void unlock_node(UctNode* node){
+    __atomic_store_n(&node->lock, 0, __ATOMIC_RELEASE);
+}
+
+static uint32_t new_node(UctTree* tree, uint64_t board, int score, int kind, int label){
+    // UCT_NONE once the arena is full, the caller then treats its node as a leaf
+    uint32_t i = __atomic_fetch_add(&tree->used, 1, __ATOMIC_RELAXED);
+    if(i >= tree->capacity){return UCT_NONE;}
+    tree->nodes[i] = (UctNode){board, 0, 0, UCT_NONE, UCT_NONE, score, kind, label, 0, 0};
+    return i;
+}
+
+static void expand_decision(UctTree* tree, UctNode* node){
+    // adds a chance child for every valid move, node->lock must be held
+    for(int m = 0; m < 4; m++){
+        if(move_unpackable_packed(node->board, m)){
+            // the child cannot be packed, get_next_move_uct redoes the search unpacked
+            __atomic_store_n(&tree->unpackable, 1, __ATOMIC_RELAXED);
+            continue;
+        }
+        int score = node->score;
+        uint64_t child = apply_move_packed(node->board, m, &score);
+        if(child == node->board){continue;}
+        uint32_t c = new_node(tree, child, score, UCT_CHANCE, m);
+        if(c == UCT_NONE){break;}
+        tree->nodes[c].next_sibling = node->first_child;
+        __atomic_store_n(&node->first_child, c, __ATOMIC_RELEASE);
+    }
+    __atomic_store_n(&node->expanded, 1, __ATOMIC_RELEASE);
+}
+
+static uint32_t select_move(UctTree* tree, UctNode* node){
+    // the chance child with the best UCB1, unvisited children first
+    double max_reward = __atomic_load_n(&tree->max_reward, __ATOMIC_RELAXED);
+    double log_visits = log(__atomic_load_n(&node->visits, __ATOMIC_RELAXED) + 1);
+    uint32_t best = UCT_NONE;
+    double best_ucb = -INFINITY;
+    for(uint32_t c = __atomic_load_n(&node->first_child, __ATOMIC_ACQUIRE); c != UCT_NONE; c = tree->nodes[c].next_sibling){
+        UctNode* child = &tree->nodes[c];
+        uint32_t visits = __atomic_load_n(&child->visits, __ATOMIC_RELAXED);
+        if(visits == 0){return c;}
+        double mean = __atomic_load_n(&child->reward_sum, __ATOMIC_RELAXED) / (double)visits;
+        double ucb = mean / (max_reward > 0 ? max_reward : 1) + tree->exploration * sqrt(log_visits / visits);
+        if(ucb > best_ucb){
+            best_ucb = ucb;
+            best = c;
+        }
+    }
+    return best;
+}
+
+static int draw_spawn(uint64_t board, Rng* rng){
+    // a spawn drawn as place_random_tile draws it, cell * 2 + value - 1
+    int empty_tiles[16];
+    int len_empty_tiles = 0;
+    for(int i = 0; i < 16; i++){
+        if(((board >> (4*i)) & 0xF) == 0){empty_tiles[len_empty_tiles++] = i;}
+    }
+    int cell = empty_tiles[rng_next(rng) % len_empty_tiles];
+    return 2 * cell + (rng_double(rng) < 0.9 ? 0 : 1);
+}
+
+static uint32_t select_spawn(UctTree* tree, UctNode* node, Rng* rng){
+    // the child for a drawn spawn, added if there is none and widening allows it
+    // otherwise spawns are redrawn until one has a child, which keeps their relative probabilities
+    uint32_t visits = __atomic_load_n(&node->visits, __ATOMIC_RELAXED);
+    double allowed = ceil(tree->widening_k * pow(visits, tree->widening_alpha));
+    for(int attempt = 0; ; attempt++){
+        int spawn = draw_spawn(node->board, rng);
+        int num_children = 0;
+        for(uint32_t c = __atomic_load_n(&node->first_child, __ATOMIC_ACQUIRE); c != UCT_NONE; c = tree->nodes[c].next_sibling){
+            if(tree->nodes[c].label == spawn){return c;}
+            num_children++;
+        }
+        if(num_children < allowed || num_children == 0 || attempt >= 64){
+            lock_node(node);
+            // another thread may have added it meanwhile
+            for(uint32_t c = node->first_child; c != UCT_NONE; c = tree->nodes[c].next_sibling){
+                if(tree->nodes[c].label == spawn){
+                    unlock_node(node);
+                    return c;
+                }
+            }
+            uint64_t child = node->board | ((uint64_t)(spawn % 2 + 1) << (4 * (spawn / 2)));
+            uint32_t c = new_node(tree, child, node->score, UCT_DECISION, spawn);
+            if(c != UCT_NONE){
+                tree->nodes[c].next_sibling = node->first_child;
+                __atomic_store_n(&node->first_child, c, __ATOMIC_RELEASE);
+            }
+            unlock_node(node);
+            return c;
+        }
+    }
+}
+
+static int rollout_from(UctNode* node, Rng* rng){
+    // final score of a game played out from a decision node, through run_rollout
+    if(!has_valid_move_packed(node->board)){return node->score;}
+    int valid_moves[4];
+    int num_valid_moves = 0;
+    for(int m = 0; m < 4; m++){
+        int gained = 0;
+        if(apply_move_packed(node->board, m, &gained) != node->board){valid_moves[num_valid_moves++] = m;}
+    }
+    Board b;
+    unpack_board(node->board, &b);
+    b.score = node->score;
+    return run_rollout(&b, valid_moves[rng_next(rng) % num_valid_moves], ROLLOUT_RANDOM, NULL);
+}
+
+static void run_iteration(UctTree* tree, Rng* rng){
+    // one selection, expansion, rollout and backup from the root (node 0)
+    uint32_t path[UCT_MAX_PATH];
+    int len = 0;
+    uint32_t n = 0;
+    int final_score;
+    while(true){
+        UctNode* node = &tree->nodes[n];
+        path[len++] = n;
+        uint32_t visits = __atomic_fetch_add(&node->visits, 1, __ATOMIC_RELAXED);
+        uint32_t next;
+        if(node->kind == UCT_DECISION){
+            if(!__atomic_load_n(&node->expanded, __ATOMIC_ACQUIRE)){
+                // a node is played out on its first visit and grows children on its second
+                if(visits == 0 || len == UCT_MAX_PATH){
+                    final_score = rollout_from(node, rng);
+                    break;
+                }
+                lock_node(node);
+                if(!node->expanded){expand_decision(tree, node);}
+                unlock_node(node);
+            }
+            next = select_move(tree, node);
+        }else{
+            next = (len < UCT_MAX_PATH) ? select_spawn(tree, node, rng) : UCT_NONE;
+        }
+        if(next == UCT_NONE){
+            // no valid move, or the arena is full
+            if(node->kind == UCT_DECISION){
+                final_score = rollout_from(node, rng);
+            }else{
+                Board b;
+                unpack_board(node->board, &b);
+                b.score = node->score;
+                place_random_tile(&b);
+                uint64_t packed;
+                pack_board(&b, &packed);
+                UctNode leaf = {packed, 0, 0, UCT_NONE, UCT_NONE, node->score, UCT_DECISION, 0, 0, 0};
+                final_score = rollout_from(&leaf, rng);
+            }
+            break;
+        }
+        n = next;
+    }
+
+    int64_t reward = final_score - tree->root_score;
+    int64_t max_reward = __atomic_load_n(&tree->max_reward, __ATOMIC_RELAXED);
+    while(reward > max_reward && !__atomic_compare_exchange_n(&tree->max_reward, &max_reward, reward, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)){}
+    for(int i = 0; i < len; i++){
+        __atomic_add_fetch(&tree->nodes[path[i]].reward_sum, reward, __ATOMIC_RELAXED);
+    }
+}
+
+static void* uct_worker(void* arg){
+    UctWorker* worker = arg;
+    UctTree* tree = worker->tree;
+    Rng rng = {worker->seed};
+    // rollouts and spawns (rollout_rand) draw from rng too, not from rand(), whose lock would serialize the workers
+    Rng* saved_rollout_rng = rollout_rng;
+    rollout_rng = &rng;
+    while(__atomic_fetch_add(&tree->next_iteration, 1, __ATOMIC_RELAXED) < tree->iterations){
+        run_iteration(tree, &rng);
+    }
+    rollout_rng = saved_rollout_rng;
+    return NULL;
+}
+
+int get_next_move_uct(int* tiles, int score, double* params){
+    /*takes in the set of tiles (in int rep form), the current score, and a set of parameters
+        [0]: iterations, rollouts per move
+        [1]: exploration constant of UCB1, rewards are scaled to [0, 1]
+        [2]: widening_k, chance nodes have at most ceil(widening_k * visits^widening_alpha) children
+        [3]: widening_alpha
+        [4]: threads searching the tree, 0 or 1 for the calling thread only
+     returns the most visited root move, UP if there is no valid move
+    */
+    search_stats = (SearchStats){0};
+    char powertiles[16];
+    intrep_to_powerrep(powertiles, tiles);
+    Board b;
+    for(int i = 0; i < 16; i++){b.tiles[i] = powertiles[i];}
+    b.score = score;
+    int valid_moves[4];
+    int num_valid_moves = get_valid_moves(&b, valid_moves);
+    if(!num_valid_moves){return UP;}
+    uint64_t packed;
+    // tiles past 32768 cannot be packed, sample the moves flat with the same number of rollouts
+    double flat_params[1] = {ceil(params[0] / num_valid_moves)};
+    if(!pack_board(&b, &packed)){
+        return get_MCTS_next_move2(tiles, score, flat_params);
+    }
+    move_tables_init();
+
+    UctTree tree = {0};
+    tree.iterations = params[0];
+    tree.exploration = params[1];
+    tree.widening_k = params[2];
+    tree.widening_alpha = params[3];
+    tree.root_score = score;
+    // an iteration adds at most a decision node's chance children and one decision node
+    uint64_t capacity = (uint64_t)tree.iterations * 5 + 16;
+    if(capacity > UINT32_MAX - 1){capacity = UINT32_MAX - 1;}
+    if(capacity > arena_capacity){
+        UctNode* grown = realloc(arena, capacity * sizeof(UctNode));
+        if(grown == NULL){return valid_moves[0];}
+        arena = grown;
+        arena_capacity = capacity;
+        pthread_once(&arena_key_once, make_arena_key);
+        pthread_setspecific(arena_key, arena);
+    }
+    tree.nodes = arena;
+    tree.capacity = arena_capacity;
+    new_node(&tree, packed, score, UCT_DECISION, 0);
+
+    event_emit(EVENT_SEARCH_BEGIN, tree.iterations, 0, 0);
+    uint64_t start = event_clock();
+    int num_threads = (params[4] > 1) ? params[4] : 1;
+    pthread_t threads[num_threads];
+    UctWorker workers[num_threads];
+    int started = 0;
+    Rng seeder = {packed ^ ((uint64_t)rollout_rand() << 32)};
+    uint64_t seed = rng_next(&seeder);
+    for(int t = 1; t < num_threads; t++){
+        workers[t] = (UctWorker){&tree, seed + t};
+        if(pthread_create(&threads[started], NULL, uct_worker, &workers[t]) == 0){started++;}
+    }
+    workers[0] = (UctWorker){&tree, seed};
+    uct_worker(&workers[0]);
+    for(int t = 0; t < started; t++){
+        pthread_join(threads[t], NULL);
+    }
+    if(tree.unpackable){
+        event_emit(EVENT_SEARCH_END, valid_moves[0], tree.used, 0);
+        return get_MCTS_next_move2(tiles, score, flat_params);
+    }
+
+    UctNode* root = &tree.nodes[0];
+    int best = valid_moves[0];
+    uint32_t best_visits = 0;
+    for(uint32_t c = root->first_child; c != UCT_NONE; c = tree.nodes[c].next_sibling){
+        if(tree.nodes[c].visits > best_visits){
+            best_visits = tree.nodes[c].visits;
+            best = tree.nodes[c].label;
+        }
+        double mean = tree.nodes[c].visits ? (double)tree.nodes[c].reward_sum / tree.nodes[c].visits : 0;
+        search_stats.move_values[tree.nodes[c].label] = mean;
+        event_emit(EVENT_ARM, tree.nodes[c].label, mean, tree.nodes[c].visits);
+    }
+    search_stats.nodes = (tree.used < tree.capacity) ? tree.used : tree.capacity;
+    event_rollouts(start, tree.iterations, root->visits ? (double)root->reward_sum / root->visits + score : score);
+    event_emit(EVENT_SEARCH_END, best, search_stats.nodes, 0);
+    return best;
+}
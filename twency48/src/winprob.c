@@ -0,0 +1,221 @@
+#include <pthread.h>
+#include <string.h>
+#include "packed.h"
+
+// Win probability
+// estimate_win_probability estimates the chance that a board goes on to hold a target multiset of
+// tiles (eg. two 1024s and a 512, as the win conditions of track_and_stop1) before the game is lost,
+// playing rollouts with the random, greedy or corner policy of rollout.c. Rollouts are run in rounds
+// of batch games shared between threads, and the estimate stops after the first round where the
+// Wilson interval of the win rate is narrower than the width asked for, so positions that are nearly
+// always (or never) won stop after a round or two rather than using a fixed count.
+// Each rollout keeps a histogram of its tiles and the number of target tiles still missing, updated
+// from the merges of each move (row_merges, the same for both directions of a row) and from each
+// spawn, so the win check is a compare rather than the recount of check_win_condition.
+// A rollout that reaches a move merging two 32768s stops there unwon, since packed boards cannot hold
+// the 65536; only targets that still miss tiles with two 32768s on the board are affected.
+// Rollout i always uses the random numbers of seed and i, so the result depends on the seed and the
+// batch size but not on the number of threads.
+
+// merges of moving a packed row, the power of the merged pair in each of the low two nibbles, 0 for none
+static uint8_t row_merges[65536];
+static pthread_once_t merges_once = PTHREAD_ONCE_INIT;
+
+static void build_row_merges(){
+    for(int r = 0; r < 65536; r++){
+        int tiles[4], n = 0;
+        for(int j = 0; j < 4; j++){
+            if((r >> (4*j)) & 0xF){tiles[n++] = (r >> (4*j)) & 0xF;}
+        }
+        // equal neighbours merge in pairs, a tile takes part in one merge per move
+        int merges = 0, shift = 0;
+        for(int i = 0; i + 1 < n; i++){
+            if(tiles[i] == tiles[i+1]){
+                merges |= tiles[i] << shift;
+                shift += 4;
+                i++;
+            }
+        }
+        row_merges[r] = merges;
+    }
+}
+
+typedef struct{
+    uint64_t board;
+    int target[16];
+    int first_move;
+    int policy;
+    double* params;
+    uint64_t seed;
+    long long next;         // next rollout of the round, taken with __atomic_fetch_add
+    long long end;          // one past the last rollout of the round
+    long long wins;         // shared counters, added to with __atomic_fetch_add
+    long long steps;
+} WinJob;
+
+typedef struct{
+    int hist[16];           // tiles of each power
+    int missing;            // sum of max(0, target - hist) over the powers
+} TileCount;
+
+static inline void add_tiles(TileCount* c, const int* target, int power, int n){
+    int before = target[power] - c->hist[power];
+    c->hist[power] += n;
+    int after = target[power] - c->hist[power];
+    c->missing += ((after > 0) ? after : 0) - ((before > 0) ? before : 0);
+}
+
+static inline void count_merges(TileCount* c, const int* target, uint64_t rows){
+    // rows: the board before the move, transposed for up and down
+    for(int r = 0; r < 4; r++){
+        for(int m = row_merges[(rows >> (16*r)) & 0xFFFF]; m; m >>= 4){
+            int power = m & 0xF;
+            // never 15, run_win_trial stops before a move that merges two 32768s
+            add_tiles(c, target, power, -2);
+            add_tiles(c, target, power + 1, 1);
+        }
+    }
+}
+
+static inline int random_move_packed(uint64_t board, Rng* rng){
+    // a uniformly random valid move, -1 if there is none
+    int valid[4], n = 0;
+    for(int m = 0; m < 4; m++){
+        int gained = 0;
+        if(apply_move_packed(board, m, &gained) != board){valid[n++] = m;}
+    }
+    return n ? valid[rng_next(rng) % n] : -1;
+}
+
+static bool run_win_trial(WinJob* job, long long index, long long* steps){
+    // plays rollout index out until the target is on the board (returns 1) or the game is lost
+    Rng rng = {job->seed ^ ((uint64_t)index * 0xd1b54a32d192ed03ULL)};
+    uint64_t b = job->board;
+    TileCount count = {{0}, 0};
+    for(int p = 1; p < 16; p++){count.missing += job->target[p];}
+    for(int i = 0; i < 16; i++){
+        int power = (b >> (4*i)) & 0xF;
+        if(power){add_tiles(&count, job->target, power, 1);}
+    }
+
+    int move = job->first_move;
+    while(count.missing > 0){
+        if(move < 0){
+            switch(job->policy){
+                case ROLLOUT_GREEDY: move = greedy_move_packed(b, job->params); break;
+                case ROLLOUT_CORNER: move = corner_move_packed(b); break;
+                default: move = random_move_packed(b, &rng); break;
+            }
+            if(move < 0){return 0;}
+        }
+        // the 65536 of two merged 32768s cannot be packed, the rollout ends there and is not counted as a win
+        if(move_unpackable_packed(b, move)){return 0;}
+        int gained = 0;
+        uint64_t child = apply_move_packed(b, move, &gained);
+        if(gained){
+            count_merges(&count, job->target, (move == LEFT || move == RIGHT) ? b : transpose_packed(b));
+        }
+        b = child;
+        move = -1;
+        (*steps)++;
+        if(count.missing <= 0){break;}
+
+        int empty = count_empty_packed(b);
+        int k = rng_next(&rng) % empty;
+        int power = (rng_double(&rng) < 0.9) ? 1 : 2;
+        for(int i = 0; i < 16; i++){
+            if((b >> (4*i)) & 0xF){continue;}
+            if(k-- == 0){
+                b |= (uint64_t)power << (4*i);
+                break;
+            }
+        }
+        add_tiles(&count, job->target, power, 1);
+    }
+    return 1;
+}
+
+static void* win_worker(void* arg){
+    WinJob* job = arg;
+    // rollouts are taken a few at a time to keep the shared counter off the hot path
+    const long long chunk = 16;
+    long long wins = 0, steps = 0;
+    while(true){
+        long long first = __atomic_fetch_add(&job->next, chunk, __ATOMIC_RELAXED);
+        if(first >= job->end){break;}
+        long long last = (first + chunk < job->end) ? first + chunk : job->end;
+        for(long long i = first; i < last; i++){
+            wins += run_win_trial(job, i, &steps);
+        }
+    }
+    __atomic_fetch_add(&job->wins, wins, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&job->steps, steps, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+static void wilson_interval(long long wins, long long n, double z, double* low, double* high){
+    double p = (double)wins / n;
+    double denom = 1 + z*z / n;
+    double centre = (p + z*z / (2*n)) / denom;
+    double half = z * sqrt(p * (1 - p) / n + z*z / (4.0*n*n)) / denom;
+    *low = (centre - half > 0) ? centre - half : 0;
+    *high = (centre + half < 1) ? centre + half : 1;
+}
+
+int estimate_win_probability(uint64_t board, int* target, int first_move, int policy, double* params, double ci_width, double z, int batch, long long max_rollouts, int num_threads, uint64_t seed, WinEstimate* result){
+    /*estimates the probability that board (packed, waiting for a move) reaches the target tiles before the game is lost
+        target: 16 entries, target[p] tiles of 2^p are needed at once, as check_win_condition
+        first_move: move played first, -1 to let the policy choose it
+        policy: ROLLOUT_RANDOM, ROLLOUT_GREEDY or ROLLOUT_CORNER, params are used by greedy as in get_next_move ([1] and [3])
+        ci_width: stops after the first round whose interval (high - low) is at most this, 0 to play max_rollouts
+        z: normal quantile of the interval, 1.96 for 95%
+        batch: rollouts per round, 0 for 1024
+        max_rollouts: rollouts to stop at whatever the interval is, rounded up to a whole round
+        num_threads: worker threads, 0 for one per core
+     checking the interval after every round stops early a little more often than a fixed count would,
+     keep batch in the hundreds or more so there are few looks
+     returns 0, -1 if an argument is not valid or first_move is not a valid move
+    */
+    *result = (WinEstimate){0};
+    if(target == NULL || target[0] != 0 || first_move > DOWN || max_rollouts < 1 || z <= 0){return -1;}
+    if(policy != ROLLOUT_RANDOM && policy != ROLLOUT_GREEDY && policy != ROLLOUT_CORNER){return -1;}
+    if(policy == ROLLOUT_GREEDY && params == NULL){return -1;}
+    move_tables_init();
+    pthread_once(&merges_once, build_row_merges);
+    if(first_move >= 0){
+        int gained = 0;
+        if(apply_move_packed(board, first_move, &gained) == board){return -1;}
+    }
+
+    WinJob job = {0};
+    job.board = board;
+    memcpy(job.target, target, sizeof(job.target));
+    job.first_move = first_move;
+    job.policy = policy;
+    job.params = params;
+    job.seed = seed;
+    if(batch <= 0){batch = 1024;}
+    if(num_threads <= 0){num_threads = sysconf(_SC_NPROCESSORS_ONLN);}
+    pthread_t threads[num_threads];
+
+    while(job.end < max_rollouts){
+        job.next = job.end;
+        job.end += batch;
+        int started = 0;
+        for(int t = 1; t < num_threads; t++){
+            if(pthread_create(&threads[started], NULL, win_worker, &job) == 0){started++;}
+        }
+        win_worker(&job);
+        for(int t = 0; t < started; t++){
+            pthread_join(threads[t], NULL);
+        }
+        result->rounds++;
+        wilson_interval(job.wins, job.end, z, &result->low, &result->high);
+        if(result->high - result->low <= ci_width){break;}
+    }
+    result->rollouts = job.end;
+    result->wins = job.wins;
+    result->steps = job.steps;
+    result->probability = (double)job.wins / job.end;
+    return 0;
+}
@@ -0,0 +1,48 @@
+#include "twency48.h"
+
+// fixed workload of seeded games, used to train the pgo build and to compare build variants
+// the scores only depend on the seeds, so every build variant must print the same ones
+
+typedef struct{
+    const char* name;
+    int engine;
+    double params[5];
+} WorkloadEntry;
+
+static const WorkloadEntry workload[] = {
+    // ExpectiMax7's tuned parameters, at depths that keep a game to a few seconds unoptimized
+    {"expectimax", ENGINE_EXPECTIMAX, {4, 10.282501707392333, 0.0, 4.480025944804589, 0}},
+    {"packed", ENGINE_PACKED, {5, 10.282501707392333, 0.0, 4.480025944804589, 0}},
+    {"mcts2", ENGINE_MCTS2, {20, 0, 0, 0, 0}},
+};
+
+int main(int argc, char** argv){
+    int num_games = (argc > 1) ? atoi(argv[1]) : 2;
+    uint64_t seed = (argc > 2) ? strtoull(argv[2], NULL, 10) : 1;
+    if(num_games < 1){
+        fprintf(stderr, "usage: %s [num_games] [seed]\n", argv[0]);
+        return 2;
+    }
+
+    GameResult* results = malloc(num_games * sizeof(GameResult));
+    double total = 0;
+    for(size_t e = 0; e < sizeof(workload) / sizeof(workload[0]); e++){
+        struct timespec start, end;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        play_games(workload[e].engine, (double*)workload[e].params, seed, num_games, NULL, results);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+        total += seconds;
+
+        long long turns = 0, score = 0;
+        for(int g = 0; g < num_games; g++){
+            turns += results[g].turns;
+            score += results[g].score;
+        }
+        printf("%-12s games %d turns %lld score %lld time %.3fs (%.1fus/turn)\n",
+            workload[e].name, num_games, turns, score, seconds, seconds * 1e6 / (turns ? turns : 1));
+    }
+    printf("total time %.3fs\n", total);
+    free(results);
+    return 0;
+}